@@ -0,0 +1,385 @@
+// Benchmark of the synthesis engine, for catching performance regressions.
+//
+// Renders every wave type in every sample format, every gen_* preset, and
+// pntr_app_sfx_sound() end to end, then writes the results as JSON to the
+// file given on the command line (or stdout). It runs headless: sounds are
+// loaded by the stand-ins in pntr_app_sfx_headless.h, so the sound case
+// times rendering and building the WAV, not an audio backend.
+//
+// With PNTR_APP_SFX_ENABLE_THREADS, it also times pntr_app_sfx_render_batch()
+// on 128 sounds with 1 thread up to the number of cores.
+//
+// Built with PNTR_APP_SFX_PROFILE (pntr_app_sfx_bench_profile), it also
+// reports where each preset spends its render time. The counters slow the
+// render loop down, so compare those timings with each other only.
+
+#include "pntr_app_sfx_headless.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// Each case is rendered for at least this long, to even out the timings.
+#define BENCH_MIN_NS 200000000ull
+
+// Fixed seeds, so every run renders the same sounds.
+#define BENCH_SEEDS 8
+
+// Sounds rendered by each pntr_app_sfx_render_batch() case.
+#define BENCH_BATCH_SEEDS 16
+
+typedef void (*BenchPreset)(pntr_app* app, SfxParams* sp);
+
+static const char* benchWaveNames[] = {"square", "sawtooth", "sine", "noise", "triangle", "pink_noise"};
+static const char* benchFormatNames[] = {"u8", "i16", "f32"};
+static const char* benchSimdNames[] = {"none", "sse2", "avx", "neon"};
+static const char* benchOscillatorNames[] = {"supersample", "polyblep"};
+
+static const char* benchPresetNames[] = {"pickup_coin", "laser_shoot", "explosion", "powerup", "hit_hurt", "jump", "blip_select", "synth"};
+static BenchPreset benchPresets[] = {
+    pntr_app_sfx_gen_pickup_coin,
+    pntr_app_sfx_gen_laser_shoot,
+    pntr_app_sfx_gen_explosion,
+    pntr_app_sfx_gen_powerup,
+    pntr_app_sfx_gen_hit_hurt,
+    pntr_app_sfx_gen_jump,
+    pntr_app_sfx_gen_blip_select,
+    pntr_app_sfx_gen_synth};
+
+#define BENCH_PRESET_COUNT (int)(sizeof(benchPresets) / sizeof(benchPresets[0]))
+
+static const int benchSupersample[] = {1, 2, 4, 8, 16};
+
+#ifdef PNTR_APP_SFX_PROFILE
+static const char* benchStageNames[] = {"envelope", "oscillator", "noise", "filter", "phaser", "output"};
+#endif
+
+// Monotonic clock, in nanoseconds.
+static uint64_t bench_time_ns(void) {
+#if defined(_WIN32)
+  LARGE_INTEGER frequency, counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#endif
+}
+
+// Peak resident memory of the process, or 0 where it is not known.
+static long long bench_peak_memory(void) {
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+    return (long long)usage.ru_maxrss;
+#else
+    return (long long)usage.ru_maxrss * 1024;
+#endif
+  }
+#endif
+  return 0;
+}
+
+#ifdef PNTR_APP_SFX_THREADS
+// Number of CPU cores, or 1 where it is not known.
+static int bench_cores(void) {
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores > 0 ? (int)cores : 1;
+#else
+  return 1;
+#endif
+}
+#endif  // PNTR_APP_SFX_THREADS
+
+// Render params over and over with pntr_app_sfx_generate_wave().
+static void bench_generate(FILE* out, const char* name, const SfxParams* params, int count, int format, bool last) {
+  int maxSamples = 0;
+  for (int i = 0; i < count; i++) {
+    int samples = pntr_app_sfx_sample_count(&params[i]);
+    if (samples > maxSamples) {
+      maxSamples = samples;
+    }
+  }
+
+  SfxSynth* synth = pntr_app_sfx_alloc_synth_samples(format, 44100, maxSamples);
+  if (synth == NULL) {
+    return;
+  }
+
+  long long samples = 0;
+  int renders = 0;
+  uint64_t start = bench_time_ns();
+  uint64_t elapsed;
+  do {
+    samples += pntr_app_sfx_generate_wave(NULL, synth, &params[renders % count]);
+    renders++;
+    elapsed = bench_time_ns() - start;
+  } while (elapsed < BENCH_MIN_NS || renders < count);
+  PNTR_FREE(synth);
+
+  fprintf(out, "    {\"name\": \"%s\", \"format\": \"%s\", \"oscillator\": \"%s\", \"renders\": %d, \"samples\": %lld, \"seconds\": %.6f, \"samplesPerSec\": %.0f}%s\n",
+          name, benchFormatNames[format], benchOscillatorNames[pntr_app_sfx_get_oscillator()], renders, samples, elapsed / 1e9, samples / (elapsed / 1e9), last ? "" : ",");
+}
+
+#ifdef PNTR_APP_SFX_THREADS
+// Render every preset over BENCH_BATCH_SEEDS seeds with pntr_app_sfx_render_batch(),
+// keeping the fastest of a few runs.
+static void bench_batch(FILE* out, int threads, double baseline, double* seconds, bool last) {
+  SfxParams params[BENCH_PRESET_COUNT * BENCH_BATCH_SEEDS];
+  SfxWave waves[BENCH_PRESET_COUNT * BENCH_BATCH_SEEDS];
+  int count = BENCH_PRESET_COUNT * BENCH_BATCH_SEEDS;
+  long long samples = 0;
+  int rendered = 0;
+
+  for (int i = 0; i < count; i++) {
+    params[i].randSeed = i / BENCH_PRESET_COUNT + 1;
+    benchPresets[i % BENCH_PRESET_COUNT](NULL, &params[i]);
+  }
+
+  *seconds = 0.0;
+  for (int run = 0; run < 5; run++) {
+    PNTR_MEMSET(waves, 0, sizeof(waves));
+    uint64_t start = bench_time_ns();
+    rendered = pntr_app_sfx_render_batch(params, count, waves, threads);
+    double elapsed = (bench_time_ns() - start) / 1e9;
+    if (run == 0 || elapsed < *seconds) {
+      *seconds = elapsed;
+    }
+
+    samples = 0;
+    for (int i = 0; i < count; i++) {
+      samples += waves[i].sampleCount;
+      pntr_app_sfx_unload_wave(&waves[i]);
+    }
+  }
+
+  fprintf(out, "    {\"threads\": %d, \"sounds\": %d, \"samples\": %lld, \"seconds\": %.6f, \"samplesPerSec\": %.0f, \"speedup\": %.2f}%s\n",
+          threads, rendered, samples, *seconds, samples / *seconds, baseline > 0.0 ? baseline / *seconds : 1.0, last ? "" : ",");
+}
+#endif  // PNTR_APP_SFX_THREADS
+
+// Add up the differences between the two oscillator modes, in float samples.
+static void bench_compare(const SfxParams* params, double* sumSquares, double* reference, double* maxError) {
+  int samples = pntr_app_sfx_sample_count(params);
+  SfxSynth* supersampled = pntr_app_sfx_alloc_synth_samples(SFX_F32, 44100, samples);
+  SfxSynth* polyblep = pntr_app_sfx_alloc_synth_samples(SFX_F32, 44100, samples);
+
+  if (supersampled != NULL && polyblep != NULL) {
+    pntr_app_sfx_set_oscillator(SFX_OSCILLATOR_SUPERSAMPLE);
+    samples = pntr_app_sfx_generate_wave(NULL, supersampled, params);
+    pntr_app_sfx_set_oscillator(SFX_OSCILLATOR_POLYBLEP);
+    pntr_app_sfx_generate_wave(NULL, polyblep, params);
+    pntr_app_sfx_set_oscillator(SFX_OSCILLATOR_SUPERSAMPLE);
+
+    for (int i = 0; i < samples; i++) {
+      double error = fabs((double)polyblep->samples.f[i] - supersampled->samples.f[i]);
+      *sumSquares += error * error;
+      *reference += (double)supersampled->samples.f[i] * supersampled->samples.f[i];
+      if (error > *maxError) {
+        *maxError = error;
+      }
+    }
+  }
+
+  PNTR_FREE(supersampled);
+  PNTR_FREE(polyblep);
+}
+
+// Render params at a supersampling factor, timing it and adding up its
+// differences from the default 8x.
+static void bench_supersample(const SfxParams* params, int factor, double* sumSquares, double* reference, long long* samples, double* seconds) {
+  int count = pntr_app_sfx_sample_count(params);
+  SfxSynth* supersampled = pntr_app_sfx_alloc_synth_samples(SFX_F32, 44100, count);
+  SfxSynth* synth = pntr_app_sfx_alloc_synth_samples(SFX_F32, 44100, count);
+
+  if (supersampled != NULL && synth != NULL) {
+    count = pntr_app_sfx_generate_wave(NULL, supersampled, params);
+    synth->supersample = factor;
+    uint64_t start = bench_time_ns();
+    pntr_app_sfx_generate_wave(NULL, synth, params);
+    *seconds += (bench_time_ns() - start) / 1e9;
+    *samples += count;
+
+    for (int i = 0; i < count; i++) {
+      double error = (double)synth->samples.f[i] - supersampled->samples.f[i];
+      *sumSquares += error * error;
+      *reference += (double)supersampled->samples.f[i] * supersampled->samples.f[i];
+    }
+  }
+
+  PNTR_FREE(supersampled);
+  PNTR_FREE(synth);
+}
+
+static void bench_run(FILE* out) {
+  SfxParams params[BENCH_SEEDS];
+
+  fprintf(out, "{\n");
+  fprintf(out, "  \"simd\": \"%s\",\n", benchSimdNames[pntr_app_sfx_get_simd()]);
+
+  // Every wave type in every format, with the same envelope and pitch
+  fprintf(out, "  \"waveTypes\": [\n");
+  for (int waveType = SFX_SQUARE; waveType <= SFX_PINK_NOISE; waveType++) {
+    pntr_app_sfx_reset_params(&params[0]);
+    params[0].randSeed = 1;
+    params[0].waveType = waveType;
+    params[0].sustainTime = 0.4f;
+    params[0].decayTime = 0.4f;
+    params[0].startFrequency = 0.3f;
+    for (int format = SFX_U8; format <= SFX_F32; format++) {
+      bench_generate(out, benchWaveNames[waveType], params, 1, format, waveType == SFX_PINK_NOISE && format == SFX_F32);
+    }
+  }
+  fprintf(out, "  ],\n");
+
+  // Every preset, over a few seeds, with both oscillator modes
+  fprintf(out, "  \"presets\": [\n");
+  for (int oscillator = SFX_OSCILLATOR_SUPERSAMPLE; oscillator <= SFX_OSCILLATOR_POLYBLEP; oscillator++) {
+    pntr_app_sfx_set_oscillator(oscillator);
+    for (int preset = 0; preset < BENCH_PRESET_COUNT; preset++) {
+      for (int seed = 0; seed < BENCH_SEEDS; seed++) {
+        params[seed].randSeed = seed + 1;
+        benchPresets[preset](NULL, &params[seed]);
+      }
+      for (int format = SFX_U8; format <= SFX_F32; format++) {
+        bench_generate(out, benchPresetNames[preset], params, BENCH_SEEDS, format,
+                       oscillator == SFX_OSCILLATOR_POLYBLEP && preset == BENCH_PRESET_COUNT - 1 && format == SFX_F32);
+      }
+    }
+  }
+  pntr_app_sfx_set_oscillator(SFX_OSCILLATOR_SUPERSAMPLE);
+  fprintf(out, "  ],\n");
+
+  // Every supersampling factor over all presets, and how far it is from 8x
+  fprintf(out, "  \"supersample\": [\n");
+  for (int factor = 0; factor < 5; factor++) {
+    double sumSquares = 0.0, reference = 0.0, seconds = 0.0;
+    long long samples = 0;
+    for (int preset = 0; preset < BENCH_PRESET_COUNT; preset++) {
+      for (int seed = 0; seed < BENCH_SEEDS; seed++) {
+        params[seed].randSeed = seed + 1;
+        benchPresets[preset](NULL, &params[seed]);
+        bench_supersample(&params[seed], benchSupersample[factor], &sumSquares, &reference, &samples, &seconds);
+      }
+    }
+    fprintf(out, "    {\"factor\": %d, \"samples\": %lld, \"seconds\": %.6f, \"samplesPerSec\": %.0f, \"relativeRms\": %.6f}%s\n",
+            benchSupersample[factor], samples, seconds, samples / seconds, reference > 0.0 ? sqrt(sumSquares / reference) : 0.0, factor == 4 ? "" : ",");
+  }
+  fprintf(out, "  ],\n");
+
+  // How far PolyBLEP output is from the 8x supersampled output, per preset
+  fprintf(out, "  \"polyblep\": [\n");
+  for (int preset = 0; preset < BENCH_PRESET_COUNT; preset++) {
+    double sumSquares = 0.0, reference = 0.0, maxError = 0.0;
+    for (int seed = 0; seed < BENCH_SEEDS; seed++) {
+      params[seed].randSeed = seed + 1;
+      benchPresets[preset](NULL, &params[seed]);
+      bench_compare(&params[seed], &sumSquares, &reference, &maxError);
+    }
+    fprintf(out, "    {\"name\": \"%s\", \"maxError\": %.6f, \"relativeRms\": %.6f}%s\n",
+            benchPresetNames[preset], maxError, reference > 0.0 ? sqrt(sumSquares / reference) : 0.0, preset == BENCH_PRESET_COUNT - 1 ? "" : ",");
+  }
+  fprintf(out, "  ],\n");
+
+  // pntr_app_sfx_sound() end to end, including the WAV and pntr_sound
+  SfxParams sounds[BENCH_PRESET_COUNT];
+  for (int preset = 0; preset < BENCH_PRESET_COUNT; preset++) {
+    sounds[preset].randSeed = preset + 1;
+    benchPresets[preset](NULL, &sounds[preset]);
+  }
+  long long samples = 0;
+  int renders = 0;
+  uint64_t start = bench_time_ns();
+  uint64_t elapsed;
+  do {
+    pntr_sound* sound = pntr_app_sfx_sound(NULL, &sounds[renders % BENCH_PRESET_COUNT]);
+    samples += pntr_app_sfx_sample_count(&sounds[renders % BENCH_PRESET_COUNT]);
+    pntr_unload_sound(sound);
+    renders++;
+    elapsed = bench_time_ns() - start;
+  } while (elapsed < BENCH_MIN_NS || renders < BENCH_PRESET_COUNT);
+  fprintf(out, "  \"sound\": {\"renders\": %d, \"samples\": %lld, \"seconds\": %.6f, \"soundsPerSec\": %.1f, \"samplesPerSec\": %.0f},\n",
+          renders, samples, elapsed / 1e9, renders / (elapsed / 1e9), samples / (elapsed / 1e9));
+
+#ifdef PNTR_APP_SFX_THREADS
+  // pntr_app_sfx_render_batch() from 1 thread up to the number of cores
+  fprintf(out, "  \"cores\": %d,\n", bench_cores());
+  fprintf(out, "  \"batch\": [\n");
+  double baseline = 0.0, seconds;
+  for (int threads = 1; threads <= bench_cores(); threads *= 2) {
+    bench_batch(out, threads, baseline, &seconds, threads * 2 > bench_cores());
+    if (threads == 1) {
+      baseline = seconds;
+    }
+  }
+  fprintf(out, "  ],\n");
+#endif
+
+#ifdef PNTR_APP_SFX_PROFILE
+  // Share of the render time of every stage, and the event counters, per preset
+  fprintf(out, "  \"profile\": [\n");
+  for (int preset = 0; preset < BENCH_PRESET_COUNT; preset++) {
+    SfxProfile profile;
+    uint64_t ticks = 0;
+    pntr_app_sfx_reset_profile();
+    for (int seed = 0; seed < BENCH_SEEDS; seed++) {
+      params[seed].randSeed = seed + 1;
+      benchPresets[preset](NULL, &params[seed]);
+      SfxSynth* synth = pntr_app_sfx_alloc_synth_samples(SFX_F32, 44100, pntr_app_sfx_sample_count(&params[seed]));
+      pntr_app_sfx_generate_wave(NULL, synth, &params[seed]);
+      PNTR_FREE(synth);
+    }
+    pntr_app_sfx_get_profile(&profile);
+    for (int stage = 0; stage < SFX_STAGE_COUNT; stage++) {
+      ticks += profile.ticks[stage];
+    }
+    fprintf(out, "    {\"name\": \"%s\", \"seconds\": %.6f", benchPresetNames[preset], profile.renderNs / 1e9);
+    for (int stage = 0; stage < SFX_STAGE_COUNT; stage++) {
+      fprintf(out, ", \"%s\": %.4f", benchStageNames[stage], ticks ? (double)profile.ticks[stage] / ticks : 0.0);
+    }
+    fprintf(out, ", \"samples\": %llu, \"subSamples\": %llu, \"noiseRefills\": %llu, \"repeatResets\": %llu, \"cutoffEnds\": %llu}%s\n",
+            (unsigned long long)profile.samples, (unsigned long long)profile.subSamples, (unsigned long long)profile.noiseRefills,
+            (unsigned long long)profile.repeatResets, (unsigned long long)profile.cutoffEnds, preset == BENCH_PRESET_COUNT - 1 ? "" : ",");
+  }
+  fprintf(out, "  ],\n");
+#endif
+
+  fprintf(out, "  \"peakMemoryBytes\": %lld\n", bench_peak_memory());
+  fprintf(out, "}\n");
+}
+
+int main(int argc, char* argv[]) {
+  FILE* out = stdout;
+
+  if (argc > 1) {
+    out = fopen(argv[1], "w");
+    if (out == NULL) {
+      fprintf(stderr, "pntr_app_sfx_bench: could not write %s\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  bench_run(out);
+
+  if (out != stdout) {
+    fclose(out);
+  }
+  return EXIT_SUCCESS;
+}
@@ -25,8 +25,25 @@ bool Init(pntr_app* app) {
   return true;
 }
 
+// Play a new sound once it has rendered in the background.
+void SfxReady(pntr_sound* sound, void* userData) {
+  AppData* appData = (AppData*)userData;
+  if (sound == NULL) {
+    return;
+  }
+  pntr_unload_sound(appData->sfx);
+  appData->sfx = sound;
+  pntr_play_sound(appData->sfx, false);
+}
+
+// Render the current params without holding up the frame.
+void PlaySfx(pntr_app* app, AppData* appData) {
+  pntr_app_sfx_sound_async_callback(app, &appData->sfx_params, SFX_U8, 0, SfxReady, appData);
+}
+
 bool Update(pntr_app* app, pntr_image* screen) {
   AppData* appData = (AppData*)pntr_app_userdata(app);
+  pntr_app_sfx_update_async();
   pntr_clear_background(screen, PNTR_RAYWHITE);
 
   pntr_draw_text(screen, appData->font, "1 - Pickup Coin", 10, 10, PNTR_DARKGRAY);
@@ -43,6 +60,7 @@ bool Update(pntr_app* app, pntr_image* screen) {
 
 void Close(pntr_app* app) {
   AppData* appData = (AppData*)pntr_app_userdata(app);
+  pntr_app_sfx_cancel_async();
   pntr_unload_sound(appData->sfx);
   pntr_unload_font(appData->font);
   pntr_unload_memory(appData);
@@ -54,44 +72,28 @@ void Event(pntr_app* app, pntr_app_event* event) {
   if (event->type == PNTR_APP_EVENTTYPE_KEY_DOWN) {
     if (event->key == PNTR_APP_KEY_1) {
       pntr_app_sfx_gen_pickup_coin(app, &appData->sfx_params);
-      pntr_unload_sound(appData->sfx);
-      appData->sfx = pntr_app_sfx_sound(app, &appData->sfx_params);
-      pntr_play_sound(appData->sfx, false);
+      PlaySfx(app, appData);
     } else if (event->key == PNTR_APP_KEY_2) {
       pntr_app_sfx_gen_laser_shoot(app, &appData->sfx_params);
-      pntr_unload_sound(appData->sfx);
-      appData->sfx = pntr_app_sfx_sound(app, &appData->sfx_params);
-      pntr_play_sound(appData->sfx, false);
+      PlaySfx(app, appData);
     } else if (event->key == PNTR_APP_KEY_3) {
       pntr_app_sfx_gen_explosion(app, &appData->sfx_params);
-      pntr_unload_sound(appData->sfx);
-      appData->sfx = pntr_app_sfx_sound(app, &appData->sfx_params);
-      pntr_play_sound(appData->sfx, false);
+      PlaySfx(app, appData);
     } else if (event->key == PNTR_APP_KEY_4) {
       pntr_app_sfx_gen_powerup(app, &appData->sfx_params);
-      pntr_unload_sound(appData->sfx);
-      appData->sfx = pntr_app_sfx_sound(app, &appData->sfx_params);
-      pntr_play_sound(appData->sfx, false);
+      PlaySfx(app, appData);
     } else if (event->key == PNTR_APP_KEY_5) {
       pntr_app_sfx_gen_hit_hurt(app, &appData->sfx_params);
-      pntr_unload_sound(appData->sfx);
-      appData->sfx = pntr_app_sfx_sound(app, &appData->sfx_params);
-      pntr_play_sound(appData->sfx, false);
+      PlaySfx(app, appData);
     } else if (event->key == PNTR_APP_KEY_6) {
       pntr_app_sfx_gen_jump(app, &appData->sfx_params);
-      pntr_unload_sound(appData->sfx);
-      appData->sfx = pntr_app_sfx_sound(app, &appData->sfx_params);
-      pntr_play_sound(appData->sfx, false);
+      PlaySfx(app, appData);
     } else if (event->key == PNTR_APP_KEY_7) {
       pntr_app_sfx_gen_blip_select(app, &appData->sfx_params);
-      pntr_unload_sound(appData->sfx);
-      appData->sfx = pntr_app_sfx_sound(app, &appData->sfx_params);
-      pntr_play_sound(appData->sfx, false);
+      PlaySfx(app, appData);
     } else if (event->key == PNTR_APP_KEY_8) {
       pntr_app_sfx_gen_synth(app, &appData->sfx_params);
-      pntr_unload_sound(appData->sfx);
-      appData->sfx = pntr_app_sfx_sound(app, &appData->sfx_params);
-      pntr_play_sound(appData->sfx, false);
+      PlaySfx(app, appData);
     }
   }
 }
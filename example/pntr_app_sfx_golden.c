@@ -0,0 +1,513 @@
+// Golden-output check of the synthesis engine, so optimizations can land safely.
+//
+// Renders a fixed corpus (every gen_* preset, over fixed seeds, in every
+// sample format, with every math mode, oscillator mode, supersampling factor,
+// sample rates from 8000 to 96000, and with SIMD on and off) and compares it to a stored reference.
+// Float samples must also all be finite:
+//
+//   pntr_app_sfx_golden write-hashes pntr_app_sfx_golden.txt
+//   pntr_app_sfx_golden check-hashes pntr_app_sfx_golden.txt
+//
+// The hash file is small enough to commit, and check-hashes runs as a ctest.
+// Hashes are of exact samples, so they only match builds that do the same
+// float math. For the differences of each sound, store reference PCM:
+//
+//   pntr_app_sfx_golden write golden.bin
+//   pntr_app_sfx_golden check golden.bin [tolerance]
+//
+// The checks exit with a failure status if any sound changed length, or
+// differs (by more than the tolerance, 0 by default).
+//
+// The mixer check plays each preset on a mixer voice, which must match the
+// sound rendered on its own, and checks rate mismatches and voice stealing:
+//
+//   pntr_app_sfx_golden mixer
+//
+// The SIMD check renders the corpus in float with the scalar render loop and
+// with the best SIMD level, and fails if they differ by more than the
+// tolerance (0.00001 by default):
+//
+//   pntr_app_sfx_golden simd [tolerance]
+
+#include "pntr_app_sfx_headless.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef void (*GoldenPreset)(pntr_app* app, SfxParams* sp);
+
+// Global settings and synth options a sound of the corpus is rendered with.
+typedef struct GoldenVariant {
+  const char* name;
+  int math;
+  int oscillator;
+  int supersample;
+  int sampleRate;
+  int simd;
+} GoldenVariant;
+
+// pntr_app_sfx_set_simd() falls back to the best level the CPU has.
+#define GOLDEN_SIMD_BEST SFX_SIMD_AVX
+
+static const GoldenVariant goldenVariants[] = {
+    {"default", SFX_MATH_PRECISE, SFX_OSCILLATOR_SUPERSAMPLE, 8, 44100, GOLDEN_SIMD_BEST},
+    {"fast_math", SFX_MATH_FAST, SFX_OSCILLATOR_SUPERSAMPLE, 8, 44100, GOLDEN_SIMD_BEST},
+    {"scalar", SFX_MATH_PRECISE, SFX_OSCILLATOR_SUPERSAMPLE, 8, 44100, SFX_SIMD_NONE},
+    {"scalar_fast_math", SFX_MATH_FAST, SFX_OSCILLATOR_SUPERSAMPLE, 8, 44100, SFX_SIMD_NONE},
+    {"polyblep", SFX_MATH_PRECISE, SFX_OSCILLATOR_POLYBLEP, 8, 44100, GOLDEN_SIMD_BEST},
+    {"supersample_1", SFX_MATH_PRECISE, SFX_OSCILLATOR_SUPERSAMPLE, 1, 44100, GOLDEN_SIMD_BEST},
+    {"supersample_2", SFX_MATH_PRECISE, SFX_OSCILLATOR_SUPERSAMPLE, 2, 44100, GOLDEN_SIMD_BEST},
+    {"supersample_4", SFX_MATH_PRECISE, SFX_OSCILLATOR_SUPERSAMPLE, 4, 44100, GOLDEN_SIMD_BEST},
+    {"supersample_16", SFX_MATH_PRECISE, SFX_OSCILLATOR_SUPERSAMPLE, 16, 44100, GOLDEN_SIMD_BEST},
+    {"rate_8000", SFX_MATH_PRECISE, SFX_OSCILLATOR_SUPERSAMPLE, 8, 8000, GOLDEN_SIMD_BEST},
+    {"rate_11025", SFX_MATH_PRECISE, SFX_OSCILLATOR_SUPERSAMPLE, 8, 11025, GOLDEN_SIMD_BEST},
+    {"polyblep_8000", SFX_MATH_PRECISE, SFX_OSCILLATOR_POLYBLEP, 8, 8000, GOLDEN_SIMD_BEST},
+    {"rate_22050", SFX_MATH_PRECISE, SFX_OSCILLATOR_SUPERSAMPLE, 8, 22050, GOLDEN_SIMD_BEST},
+    {"rate_48000", SFX_MATH_PRECISE, SFX_OSCILLATOR_SUPERSAMPLE, 8, 48000, GOLDEN_SIMD_BEST},
+    {"rate_96000", SFX_MATH_PRECISE, SFX_OSCILLATOR_SUPERSAMPLE, 8, 96000, GOLDEN_SIMD_BEST}};
+
+static const char* goldenFormatNames[] = {"u8", "i16", "f32"};
+static const char* goldenPresetNames[] = {"pickup_coin", "laser_shoot", "explosion", "powerup", "hit_hurt", "jump", "blip_select", "synth"};
+static GoldenPreset goldenPresets[] = {
+    pntr_app_sfx_gen_pickup_coin,
+    pntr_app_sfx_gen_laser_shoot,
+    pntr_app_sfx_gen_explosion,
+    pntr_app_sfx_gen_powerup,
+    pntr_app_sfx_gen_hit_hurt,
+    pntr_app_sfx_gen_jump,
+    pntr_app_sfx_gen_blip_select,
+    pntr_app_sfx_gen_synth};
+static const uint32_t goldenSeeds[] = {1, 2, 3, 33, 42, 1234, 0xBEEF};
+
+#define GOLDEN_VARIANT_COUNT (int)(sizeof(goldenVariants) / sizeof(goldenVariants[0]))
+#define GOLDEN_PRESET_COUNT (int)(sizeof(goldenPresets) / sizeof(goldenPresets[0]))
+#define GOLDEN_SEED_COUNT (int)(sizeof(goldenSeeds) / sizeof(goldenSeeds[0]))
+
+// Each sound in the PCM file: this header, then sampleCount floats.
+typedef struct GoldenEntry {
+  int32_t variant;
+  int32_t preset;
+  uint32_t seed;
+  int32_t format;
+  int32_t sampleCount;
+  uint64_t hash;  // FNV-1a of the samples, in their own format
+} GoldenEntry;
+
+static uint64_t golden_hash(const void* data, size_t size) {
+  const unsigned char* bytes = (const unsigned char*)data;
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+// The sample at i, from -1 to 1 whatever the format.
+static float golden_sample(const SfxSynth* synth, int i) {
+  switch (synth->sampleFormat) {
+    case SFX_U8:
+      return (synth->samples.u8[i] - 128) / 128.0f;
+    case SFX_I16:
+      return synth->samples.i16[i] / 32768.0f;
+    default:
+      return synth->samples.f[i];
+  }
+}
+
+// Render one sound of the corpus at a SIMD level, returning NULL if it could
+// not be allocated.
+static SfxSynth* golden_render_simd(int variant, int preset, uint32_t seed, int format, int simd, GoldenEntry* entry) {
+  static const int bytesPerSample[] = {1, 2, 4};
+  const GoldenVariant* v = &goldenVariants[variant];
+  SfxParams params;
+  SfxSynth* synth;
+
+  params.randSeed = seed;
+  goldenPresets[preset](NULL, &params);
+
+  synth = pntr_app_sfx_alloc_synth_samples(format, v->sampleRate, pntr_app_sfx_sample_count_ex(&params, v->sampleRate));
+  if (synth == NULL) {
+    fprintf(stderr, "pntr_app_sfx_golden: out of memory\n");
+    return NULL;
+  }
+  synth->supersample = v->supersample;
+
+  pntr_app_sfx_set_math(v->math);
+  pntr_app_sfx_set_oscillator(v->oscillator);
+  pntr_app_sfx_set_simd(simd);
+
+  entry->variant = variant;
+  entry->preset = preset;
+  entry->seed = seed;
+  entry->format = format;
+  entry->sampleCount = pntr_app_sfx_generate_wave(NULL, synth, &params);
+  entry->hash = golden_hash(synth->samples.u8, (size_t)entry->sampleCount * bytesPerSample[format]);
+  return synth;
+}
+
+// Render one sound of the corpus, like its variant says.
+static SfxSynth* golden_render(int variant, int preset, uint32_t seed, int format, GoldenEntry* entry) {
+  return golden_render_simd(variant, preset, seed, format, goldenVariants[variant].simd, entry);
+}
+
+// Whether every sample is a number. Only float samples can tell, since NaN
+// has no integer form.
+static bool golden_finite(const SfxSynth* synth, int sampleCount) {
+  if (synth->sampleFormat != SFX_F32) {
+    return true;
+  }
+  for (int i = 0; i < sampleCount; i++) {
+    if (!isfinite(synth->samples.f[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void golden_print(const GoldenEntry* entry, int sampleCount, float maxError, double rms, const char* result) {
+  printf("%-16s %-12s seed %-6u %-3s  samples %6d/%-6d  max %.6f  rms %.6f  %s\n",
+         goldenVariants[entry->variant].name, goldenPresetNames[entry->preset], entry->seed, goldenFormatNames[entry->format],
+         sampleCount, entry->sampleCount, maxError, rms, result);
+}
+
+static bool golden_write(FILE* file, bool hashes) {
+  GoldenEntry entry;
+  float sample;
+  int sounds = 0;
+
+  for (int variant = 0; variant < GOLDEN_VARIANT_COUNT; variant++) {
+    for (int preset = 0; preset < GOLDEN_PRESET_COUNT; preset++) {
+      for (int seed = 0; seed < GOLDEN_SEED_COUNT; seed++) {
+        for (int format = SFX_U8; format <= SFX_F32; format++) {
+          SfxSynth* synth = golden_render(variant, preset, goldenSeeds[seed], format, &entry);
+          if (synth == NULL) {
+            return false;
+          }
+          if (!golden_finite(synth, entry.sampleCount)) {
+            golden_print(&entry, entry.sampleCount, 0.0f, 0.0, "NOT FINITE");
+            PNTR_FREE(synth);
+            return false;
+          }
+
+          bool written = true;
+          if (hashes) {
+            written = fprintf(file, "%s %s %u %s %d %016llx\n", goldenVariants[variant].name, goldenPresetNames[preset], entry.seed,
+                              goldenFormatNames[format], entry.sampleCount, (unsigned long long)entry.hash) > 0;
+          } else {
+            written = fwrite(&entry, sizeof(GoldenEntry), 1, file) == 1;
+            for (int i = 0; written && i < entry.sampleCount; i++) {
+              sample = golden_sample(synth, i);
+              written = fwrite(&sample, sizeof(float), 1, file) == 1;
+            }
+          }
+          PNTR_FREE(synth);
+
+          if (!written) {
+            fprintf(stderr, "pntr_app_sfx_golden: could not write the reference\n");
+            return false;
+          }
+          sounds++;
+        }
+      }
+    }
+  }
+
+  printf("Wrote %d sounds\n", sounds);
+  return true;
+}
+
+// Find a name in names[0..count-1], or return -1.
+static int golden_find(const char* name, const char* const* names, int count) {
+  for (int i = 0; i < count; i++) {
+    if (strcmp(name, names[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static bool golden_check_hashes(FILE* file) {
+  const char* variantNames[GOLDEN_VARIANT_COUNT];
+  char variantName[32], presetName[32], formatName[8];
+  unsigned long long hash;
+  unsigned int seed;
+  int sampleCount, sounds = 0, failed = 0;
+  GoldenEntry expected, actual;
+
+  for (int variant = 0; variant < GOLDEN_VARIANT_COUNT; variant++) {
+    variantNames[variant] = goldenVariants[variant].name;
+  }
+
+  int fields;
+  while ((fields = fscanf(file, "%31s %31s %u %7s %d %llx", variantName, presetName, &seed, formatName, &sampleCount, &hash)) == 6) {
+    expected.variant = golden_find(variantName, variantNames, GOLDEN_VARIANT_COUNT);
+    expected.preset = golden_find(presetName, goldenPresetNames, GOLDEN_PRESET_COUNT);
+    expected.format = golden_find(formatName, goldenFormatNames, 3);
+    if (expected.variant < 0 || expected.preset < 0 || expected.format < 0 || sampleCount < 0) {
+      fprintf(stderr, "pntr_app_sfx_golden: unknown sound %s %s %s\n", variantName, presetName, formatName);
+      return false;
+    }
+    expected.seed = seed;
+    expected.sampleCount = sampleCount;
+
+    SfxSynth* synth = golden_render(expected.variant, expected.preset, expected.seed, expected.format, &actual);
+    if (synth == NULL) {
+      return false;
+    }
+    bool finite = golden_finite(synth, actual.sampleCount);
+    PNTR_FREE(synth);
+
+    // Only report the sounds that changed, the corpus is large.
+    if (!finite) {
+      golden_print(&expected, actual.sampleCount, 0.0f, 0.0, "NOT FINITE");
+      failed++;
+    } else if (actual.sampleCount != expected.sampleCount || actual.hash != (uint64_t)hash) {
+      golden_print(&expected, actual.sampleCount, 0.0f, 0.0, "FAILED");
+      failed++;
+    }
+    sounds++;
+  }
+
+  if (fields != EOF || ferror(file)) {
+    fprintf(stderr, "pntr_app_sfx_golden: could not read line %d of the hashes\n", sounds + 1);
+    return false;
+  }
+
+  printf("%d of %d sounds passed\n", sounds - failed, sounds);
+  return sounds > 0 && failed == 0;
+}
+
+static bool golden_check(FILE* file, float tolerance) {
+  GoldenEntry expected, actual;
+  int sounds = 0, failed = 0;
+  float reference;
+
+  while (fread(&expected, sizeof(GoldenEntry), 1, file) == 1) {
+    if (expected.variant < 0 || expected.variant >= GOLDEN_VARIANT_COUNT || expected.preset < 0 || expected.preset >= GOLDEN_PRESET_COUNT ||
+        expected.format < SFX_U8 || expected.format > SFX_F32 || expected.sampleCount < 0) {
+      fprintf(stderr, "pntr_app_sfx_golden: the reference is corrupt\n");
+      return false;
+    }
+
+    SfxSynth* synth = golden_render(expected.variant, expected.preset, expected.seed, expected.format, &actual);
+    if (synth == NULL) {
+      return false;
+    }
+
+    // Compare over the samples both have, and count any length change as a failure.
+    double sumSquares = 0.0;
+    float maxError = 0.0f, error;
+    for (int i = 0; i < expected.sampleCount; i++) {
+      if (fread(&reference, sizeof(float), 1, file) != 1) {
+        fprintf(stderr, "pntr_app_sfx_golden: the reference is truncated\n");
+        PNTR_FREE(synth);
+        return false;
+      }
+      if (i < actual.sampleCount) {
+        error = golden_sample(synth, i) - reference;
+        error = error < 0 ? -error : error;
+        maxError = error > maxError ? error : maxError;
+        sumSquares += (double)error * error;
+      }
+    }
+    bool finite = golden_finite(synth, actual.sampleCount);
+    PNTR_FREE(synth);
+
+    double rms = expected.sampleCount > 0 ? sqrt(sumSquares / expected.sampleCount) : 0.0;
+    bool same = actual.hash == expected.hash && actual.sampleCount == expected.sampleCount && maxError == 0.0f;
+    bool passed = finite && actual.sampleCount == expected.sampleCount && maxError <= tolerance;
+    golden_print(&expected, actual.sampleCount, maxError, rms, !finite ? "NOT FINITE" : same ? "identical" : passed ? "within tolerance" : "FAILED");
+
+    sounds++;
+    failed += !passed;
+  }
+
+  if (ferror(file)) {
+    fprintf(stderr, "pntr_app_sfx_golden: could not read the reference\n");
+    return false;
+  }
+
+  printf("%d of %d sounds passed\n", sounds - failed, sounds);
+  return sounds > 0 && failed == 0;
+}
+
+// Render every sound of the corpus in float with the scalar render loop and
+// with a SIMD level, and check they differ by at most tolerance.
+static bool golden_compare_simd(int simd, const char* name, float tolerance) {
+  GoldenEntry scalarEntry, simdEntry;
+  int failed = 0;
+
+  for (int variant = 0; variant < GOLDEN_VARIANT_COUNT; variant++) {
+    float maxError = 0.0f, error;
+    bool passed = true;
+
+    for (int preset = 0; preset < GOLDEN_PRESET_COUNT; preset++) {
+      for (int seed = 0; seed < GOLDEN_SEED_COUNT; seed++) {
+        SfxSynth* scalar = golden_render_simd(variant, preset, goldenSeeds[seed], SFX_F32, SFX_SIMD_NONE, &scalarEntry);
+        SfxSynth* vector = golden_render_simd(variant, preset, goldenSeeds[seed], SFX_F32, simd, &simdEntry);
+        if (scalar == NULL || vector == NULL) {
+          PNTR_FREE(scalar);
+          PNTR_FREE(vector);
+          return false;
+        }
+
+        passed = passed && scalarEntry.sampleCount == simdEntry.sampleCount && golden_finite(vector, simdEntry.sampleCount);
+        for (int i = 0; i < scalarEntry.sampleCount && i < simdEntry.sampleCount; i++) {
+          error = scalar->samples.f[i] - vector->samples.f[i];
+          error = error < 0 ? -error : error;
+          maxError = error > maxError ? error : maxError;
+        }
+        PNTR_FREE(scalar);
+        PNTR_FREE(vector);
+      }
+    }
+
+    passed = passed && maxError <= tolerance;
+    printf("%-5s %-16s max %.9f  %s\n", name, goldenVariants[variant].name, maxError, passed ? "passed" : "FAILED");
+    failed += !passed;
+  }
+  return failed == 0;
+}
+
+// Compare every SIMD level this build and CPU have with the scalar render loop.
+static bool golden_check_simd(float tolerance) {
+  static const int levels[] = {SFX_SIMD_SSE2, SFX_SIMD_AVX, SFX_SIMD_NEON};
+  static const char* names[] = {"sse2", "avx", "neon"};
+  int compared = 0, failed = 0;
+
+  for (int i = 0; i < 3; i++) {
+    if (pntr_app_sfx_set_simd(levels[i]) == levels[i]) {
+      failed += !golden_compare_simd(levels[i], names[i], tolerance);
+      compared++;
+    }
+  }
+
+  if (compared == 0) {
+    printf("No SIMD level in this build, nothing to compare\n");
+  }
+  return failed == 0;
+}
+
+// Mix one voice of each preset at gain 1, started from params and from a
+// patch, and compare it to the sound rendered on its own.
+static bool golden_mix(SfxMixer* mixer, const SfxParams* params, const SfxPatch* patch, const SfxSynth* synth, int sampleCount) {
+  float block[1000];
+  uint32_t voice = patch != NULL ? pntr_app_sfx_mixer_play_patch(mixer, patch, 1.0f, 0) : pntr_app_sfx_mixer_play(mixer, params, 1.0f, 0);
+  int frames;
+
+  if (voice == 0) {
+    return false;
+  }
+  for (int offset = 0; offset < sampleCount; offset += frames) {
+    frames = sampleCount - offset < 1000 ? sampleCount - offset : 1000;
+    if (pntr_app_sfx_mixer_render(mixer, block, frames, SFX_F32) != 1) {
+      return false;
+    }
+    for (int i = 0; i < frames; i++) {
+      if (block[i] != synth->samples.f[offset + i]) {
+        return false;
+      }
+    }
+  }
+
+  // The voice frees itself on the block after its last sample.
+  pntr_app_sfx_mixer_render(mixer, block, 1, SFX_F32);
+  return !pntr_app_sfx_mixer_playing(mixer, voice);
+}
+
+static bool golden_check_mixer(void) {
+  SfxMixer* mixer = pntr_app_sfx_load_mixer(2, 44100);
+  SfxPatch* patch = (SfxPatch*)PNTR_MALLOC(sizeof(SfxPatch));
+  SfxParams params;
+  GoldenEntry entry;
+  int failed = 0;
+
+  if (mixer == NULL || patch == NULL) {
+    fprintf(stderr, "pntr_app_sfx_golden: out of memory\n");
+    pntr_app_sfx_unload_mixer(mixer);
+    PNTR_FREE(patch);
+    return false;
+  }
+
+  for (int preset = 0; preset < GOLDEN_PRESET_COUNT; preset++) {
+    SfxSynth* synth = golden_render(0, preset, 42, SFX_F32, &entry);
+    if (synth == NULL) {
+      failed++;
+      break;
+    }
+    params.randSeed = 42;
+    goldenPresets[preset](NULL, &params);
+
+    bool mixed = golden_mix(mixer, &params, NULL, synth, entry.sampleCount);
+    pntr_app_sfx_compile_ex(&params, patch, 44100);
+    mixed = mixed && golden_mix(mixer, NULL, patch, synth, entry.sampleCount);
+    PNTR_FREE(synth);
+
+    printf("mixer %-12s %s\n", goldenPresetNames[preset], mixed ? "identical" : "FAILED");
+    failed += !mixed;
+  }
+
+  // A patch compiled at another rate is refused.
+  pntr_app_sfx_compile_ex(&params, patch, 22050);
+  bool refused = pntr_app_sfx_mixer_play_patch(mixer, patch, 1.0f, 0) == 0;
+  printf("mixer %-12s %s\n", "other_rate", refused ? "refused" : "FAILED");
+  failed += !refused;
+
+  // With every voice busy, a lower priority is dropped and an equal one steals the oldest.
+  uint32_t first = pntr_app_sfx_mixer_play(mixer, &params, 1.0f, 1);
+  uint32_t second = pntr_app_sfx_mixer_play(mixer, &params, 1.0f, 1);
+  bool dropped = pntr_app_sfx_mixer_play(mixer, &params, 1.0f, 0) == 0;
+  uint32_t third = pntr_app_sfx_mixer_play(mixer, &params, 1.0f, 1);
+  bool stolen = third != 0 && !pntr_app_sfx_mixer_playing(mixer, first) && pntr_app_sfx_mixer_playing(mixer, second);
+  printf("mixer %-12s %s\n", "priority", dropped && stolen ? "passed" : "FAILED");
+  failed += !(dropped && stolen);
+
+  pntr_app_sfx_unload_mixer(mixer);
+  PNTR_FREE(patch);
+  return failed == 0;
+}
+
+int main(int argc, char* argv[]) {
+  const char* mode = argc > 2 ? argv[1] : "";
+  bool write = strcmp(mode, "write") == 0;
+  bool check = strcmp(mode, "check") == 0;
+  bool writeHashes = strcmp(mode, "write-hashes") == 0;
+  bool checkHashes = strcmp(mode, "check-hashes") == 0;
+  bool passed;
+
+  if (argc == 2 && strcmp(argv[1], "mixer") == 0) {
+    return golden_check_mixer() ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (argc >= 2 && argc <= 3 && strcmp(argv[1], "simd") == 0) {
+    return golden_check_simd(argc > 2 ? (float)atof(argv[2]) : 0.00001f) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if (!write && !check && !writeHashes && !checkHashes) {
+    fprintf(stderr, "Usage: pntr_app_sfx_golden write|check|write-hashes|check-hashes <file> [tolerance]\n");
+    fprintf(stderr, "       pntr_app_sfx_golden mixer\n");
+    fprintf(stderr, "       pntr_app_sfx_golden simd [tolerance]\n");
+    return EXIT_FAILURE;
+  }
+
+  FILE* file = fopen(argv[2], write ? "wb" : check ? "rb" : writeHashes ? "w" : "r");
+  if (file == NULL) {
+    fprintf(stderr, "pntr_app_sfx_golden: could not open %s\n", argv[2]);
+    return EXIT_FAILURE;
+  }
+
+  if (write || writeHashes) {
+    passed = golden_write(file, writeHashes);
+  } else if (check) {
+    passed = golden_check(file, argc > 3 ? (float)atof(argv[3]) : 0.0f);
+  } else {
+    passed = golden_check_hashes(file);
+  }
+
+  if (fclose(file) != 0 && (write || writeHashes)) {
+    fprintf(stderr, "pntr_app_sfx_golden: could not write %s\n", argv[2]);
+    passed = false;
+  }
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -17,8 +17,17 @@ typedef struct AppData {
   pntr_font* font;
   SfxParams sfx_params;
   struct nk_context* ctx;
+  SfxCache* cache;
+  nk_bool live;                // Live preview: play the params again as they change
+  SfxParams liveParams;        // Params the live preview last saw
+  int liveDelay;               // Frames until liveParams are rendered, 0 when idle
+  SfxAsyncSound* liveRender;   // Background render of liveParams
+  pntr_sound* liveSound;       // Latest live preview
 } AppData;
 
+// Frames the params have to stay unchanged before the live preview renders them.
+#define LIVE_PREVIEW_DELAY 6
+
 // this will allow user to select a save-file and download
 #ifdef EMSCRIPTEN
 EM_ASYNC_JS(void, download_rfx_file, (unsigned char* dataPtr, int size, char* suggestedNamePtr, char* startInPtr, char* mimeTypePtr), {
@@ -107,8 +116,11 @@ bool Init(pntr_app* app) {
   AppData* appData = pntr_load_memory(sizeof(AppData));
   pntr_app_set_userdata(app, appData);
 
+  // replaying unchanged params reuses the rendered sound
+  appData->cache = pntr_app_sfx_load_cache(1024 * 1024);
+
   pntr_app_sfx_gen_jump(app, &appData->sfx_params);
-  appData->sfx = pntr_app_sfx_sound(app, &appData->sfx_params);
+  appData->sfx = pntr_app_sfx_cache_sound_ex(app, appData->cache, &appData->sfx_params, PNTR_APP_SFX_NATIVE_FORMAT, 0);
 
   appData->font = pntr_load_font_default();
 
@@ -119,9 +131,55 @@ bool Init(pntr_app* app) {
 
 void pntr_app_sfx_gen_play(pntr_app* app) {
   AppData* appData = (AppData*)pntr_app_userdata(app);
-  pntr_unload_sound(appData->sfx);
-  appData->sfx = pntr_app_sfx_sound(app, &appData->sfx_params);
+  pntr_app_sfx_cache_release(appData->cache, appData->sfx);
+  appData->sfx = pntr_app_sfx_cache_sound_ex(app, appData->cache, &appData->sfx_params, PNTR_APP_SFX_NATIVE_FORMAT, 0);
   pntr_play_sound(appData->sfx, false);
+
+  // These params are playing already, so the live preview has nothing to do.
+  appData->liveParams = appData->sfx_params;
+  appData->liveDelay = 0;
+  pntr_app_sfx_unload_async(appData->liveRender);
+  appData->liveRender = NULL;
+}
+
+// Render the params in the background once they stop changing, and play them
+// when they are ready. Dragging a slider only restarts the wait, so the UI
+// keeps its frame rate.
+void live_preview_update(pntr_app* app, AppData* appData) {
+  if (!appData->live) {
+    appData->liveParams = appData->sfx_params;
+    return;
+  }
+
+  if (memcmp(&appData->liveParams, &appData->sfx_params, sizeof(SfxParams)) != 0) {
+    // Drop the render of the old params, and wait for the new ones to settle.
+    appData->liveParams = appData->sfx_params;
+    appData->liveDelay = LIVE_PREVIEW_DELAY;
+    pntr_app_sfx_unload_async(appData->liveRender);
+    appData->liveRender = NULL;
+    return;
+  }
+
+  if (appData->liveDelay > 0 && --appData->liveDelay == 0) {
+    appData->liveRender = pntr_app_sfx_sound_async_ex(app, &appData->liveParams, PNTR_APP_SFX_NATIVE_FORMAT, 0);
+  }
+
+  if (appData->liveRender != NULL && pntr_app_sfx_async_ready(appData->liveRender)) {
+    pntr_sound* sound = pntr_app_sfx_async_sound(appData->liveRender);
+    pntr_app_sfx_unload_async(appData->liveRender);
+    appData->liveRender = NULL;
+
+    // Swap to the new version as it starts playing.
+    if (sound != NULL) {
+      if (appData->liveSound != NULL) {
+        pntr_stop_sound(appData->liveSound);
+        pntr_unload_sound(appData->liveSound);
+      }
+      pntr_stop_sound(appData->sfx);
+      appData->liveSound = sound;
+      pntr_play_sound(appData->liveSound, false);
+    }
+  }
 }
 
 bool Update(pntr_app* app, pntr_image* screen) {
@@ -180,10 +238,11 @@ bool Update(pntr_app* app, pntr_image* screen) {
 
   // Play
   if (nk_begin(ctx, "Play", nk_rect(screen->width / 3, 0, (screen->width / 3), screen->height / 6), NK_WINDOW_NO_SCROLLBAR)) {
-    nk_layout_row_dynamic(ctx, 0, 1);
+    nk_layout_row_dynamic(ctx, 0, 2);
     if (nk_button_label(ctx, "Play")) {
       pntr_app_sfx_gen_play(app);
     }
+    nk_checkbox_label(ctx, "Live", &appData->live);
   }
   nk_end(ctx);
 
@@ -285,6 +344,8 @@ bool Update(pntr_app* app, pntr_image* screen) {
   }
   nk_end(ctx);
 
+  live_preview_update(app, appData);
+
   pntr_draw_nuklear(screen, ctx);
 
   return true;
@@ -293,7 +354,11 @@ bool Update(pntr_app* app, pntr_image* screen) {
 void Close(pntr_app* app) {
   AppData* appData = (AppData*)pntr_app_userdata(app);
   pntr_unload_nuklear(appData->ctx);
-  pntr_unload_sound(appData->sfx);
+  pntr_app_sfx_unload_async(appData->liveRender);
+  if (appData->liveSound != NULL) {
+    pntr_unload_sound(appData->liveSound);
+  }
+  pntr_app_sfx_unload_cache(appData->cache);
   pntr_unload_font(appData->font);
   pntr_unload_memory(appData);
 }
@@ -0,0 +1,60 @@
+// Headless stand-ins for the pntr_app functions pntr_app_sfx.h calls, so the
+// benchmark and tests build as plain command-line programs without a window,
+// audio device or platform library.
+//
+// Only the pntr_app declarations are used, not its implementation. Sounds
+// are kept as the WAV data they were loaded from, and never played.
+
+#ifndef PNTR_APP_SFX_HEADLESS_H__
+#define PNTR_APP_SFX_HEADLESS_H__
+
+// libm's sinf for SFX_MATH_PRECISE, so the golden hashes do not depend on
+// pntr's own approximation.
+#define PNTR_IMPLEMENTATION
+#define PNTR_ENABLE_MATH
+#include "pntr.h"
+#include "pntr_app.h"
+
+#define PNTR_APP_SFX_IMPLEMENTATION
+#include "pntr_app_sfx.h"
+
+struct pntr_sound {
+  unsigned char* data;
+  unsigned int dataSize;
+};
+
+pntr_sound* pntr_load_sound_from_memory(pntr_app_sound_type type, unsigned char* data, unsigned int dataSize) {
+  pntr_sound* sound;
+
+  if (type != PNTR_APP_SOUND_TYPE_WAV || data == NULL) {
+    PNTR_FREE(data);
+    return NULL;
+  }
+
+  sound = (pntr_sound*)PNTR_MALLOC(sizeof(pntr_sound));
+  if (sound == NULL) {
+    PNTR_FREE(data);
+    return NULL;
+  }
+
+  // Like pntr_app, the sound takes ownership of data.
+  sound->data = data;
+  sound->dataSize = dataSize;
+  return sound;
+}
+
+void pntr_unload_sound(pntr_sound* sound) {
+  if (sound != NULL) {
+    PNTR_FREE(sound->data);
+    PNTR_FREE(sound);
+  }
+}
+
+// Only reached with a pntr_app, which headless programs do not have.
+int pntr_app_random(pntr_app* app, int min, int max) {
+  (void)app;
+  (void)max;
+  return min;
+}
+
+#endif  // PNTR_APP_SFX_HEADLESS_H__
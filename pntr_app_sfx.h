@@ -1,6 +1,7 @@
 #ifndef PNTR_APP_SFX_H__
 #define PNTR_APP_SFX_H__
 
+#include <stddef.h>
 #include <stdint.h>
 
 // Apply squareDuty to sawtooth waveform.
@@ -95,27 +96,362 @@ enum SfxSampleFormat {
   SFX_F32   // float
 };
 
+// The sample format the pntr_app backend mixes in, so sounds from
+// pntr_app_sfx_sound_ex() load without a conversion pass.
+#ifndef PNTR_APP_SFX_NATIVE_FORMAT
+#if defined(PNTR_APP_RAYLIB) || defined(PNTR_APP_WEB)
+#define PNTR_APP_SFX_NATIVE_FORMAT SFX_F32
+#else
+#define PNTR_APP_SFX_NATIVE_FORMAT SFX_I16
+#endif
+#endif
+
+enum SfxSimdLevel {
+  SFX_SIMD_NONE,  // Scalar render loop
+  SFX_SIMD_SSE2,
+  SFX_SIMD_AVX,  // Selected at runtime when the CPU supports it (float ops only, so AVX2 is not needed)
+  SFX_SIMD_NEON
+};
+
+enum SfxMathMode {
+  SFX_MATH_PRECISE,  // PNTR_SINF for sine waves and vibrato
+  SFX_MATH_FAST      // Polynomial sine, within 4e-6 of the precise one
+};
+
+enum SfxOscillatorMode {
+  SFX_OSCILLATOR_SUPERSAMPLE,  // supersample (8 by default) sub-samples per sample, box-filtered
+  SFX_OSCILLATOR_POLYBLEP      // 1 band-limited (PolyBLEP/BLAMP) sample per sample
+};
+
+// Stages of the render loop, timed in PNTR_APP_SFX_PROFILE builds.
+enum SfxProfileStage {
+  SFX_STAGE_ENVELOPE,    // Slides, vibrato, arpeggio, repeats, sweeps and the volume envelope
+  SFX_STAGE_OSCILLATOR,  // Waveforms of every sub-sample
+  SFX_STAGE_NOISE,       // Noise buffer refills (RESET_NOISE)
+  SFX_STAGE_FILTER,      // Low-pass and high-pass filters
+  SFX_STAGE_PHASER,      // Phaser, and mixing sub-samples down to one sample
+  SFX_STAGE_OUTPUT,      // Clamping, silence detection and sample conversion
+  SFX_STAGE_COUNT
+};
+
+// Render loop counters. Only PNTR_APP_SFX_PROFILE builds count them, and they
+// stay zero elsewhere, but the struct is always defined so that SfxSynthState
+// has the same layout whether or not a file defines the macro. Ticks come
+// from the CPU cycle counter where there is one, and are nanoseconds elsewhere.
+typedef struct SfxProfile {
+  uint64_t ticks[SFX_STAGE_COUNT];  // Time spent in each stage
+  uint64_t renderNs;                // Time spent in pntr_app_sfx_render(), counters included
+  uint64_t renders;                 // pntr_app_sfx_render() calls
+  uint64_t samples;                 // Samples written
+  uint64_t subSamples;              // Oscillator sub-samples rendered
+  uint64_t noiseRefills;            // RESET_NOISE runs
+  uint64_t repeatResets;            // Restarts from repeatSpeed
+  uint64_t silentSamples;           // Leading silence skipped by silence detection
+  uint64_t envelopeEnds;            // Sounds ended by their envelope
+  uint64_t cutoffEnds;              // Sounds ended early by minFrequency
+  uint64_t silenceEnds;             // Sounds ended early by silence detection
+} SfxProfile;
+
+// Highest sample rate sounds render at. The phaser delay line grows with the
+// rate, and has room for 4x the 1024 sub-samples sfxr uses at 44100.
+#define PNTR_APP_SFX_MAX_SAMPLE_RATE 176400
+
+// SfxParams compiled for rendering: every coefficient of the render loop,
+// derived once by pntr_app_sfx_compile() instead of on every render and repeat.
+typedef struct SfxPatch {
+  // Oscillator, restored on every repeat
+  double fperiod;
+  double fmaxperiod;
+  double fslide;
+  double fdslide;
+  double arpeggioModulation;
+  int period;
+  int arpeggioLimit;
+  float squareDuty;
+  float squareSlide;
+  float minFreq;
+
+  // Envelope and repeat
+  int envLength[3];
+  float sustainPunch;
+  int repeatLimit;
+
+  // Filters
+  float fltw;
+  float fltwd;
+  float fltdmp;
+  float flthp;
+  float flthpd;
+
+  // Vibrato and phaser
+  float vibratoSpeed;
+  float vibratoAmplitude;
+  float fphase;
+  float fdphase;
+  int phaserLimit;    // Longest phaser delay in sub-samples, 1023 at 44100
+  int minPeriod;      // Shortest oscillator period in sub-samples, 8 at 44100 and below
+
+  int waveType;
+  int kernelFlags;    // Optional stages this sound uses
+  uint32_t randSeed;
+  int sampleRate;
+  double rateScale;   // Sample rate / 44100, which the sfxr time constants assume
+} SfxPatch;
+
+// Resumable render state, so a sound can be synthesized a block at a time.
+typedef struct SfxSynthState {
+  SfxPatch patch;    // Copy of the compiled parameters being rendered
+  uint32_t rng;      // Noise generator, seeded from patch.randSeed
+  int sampleFormat;  // Format written by pntr_app_sfx_render()
+  int kernelFlags;   // Stages used by this sound, picks the render kernel
+  int mathMode;      // SfxMathMode at pntr_app_sfx_begin_render()
+  int simd;          // SfxSimdLevel at pntr_app_sfx_begin_render()
+  int supersample;   // Sub-samples per sample: 1, 2, 4, 8 (the default) or 16
+  float silenceThreshold;  // Amplitude below which output is silence, 0 to keep everything
+  int silenceHold;         // Samples of silence after the attack that end the sound
+  int finished;      // Set once the envelope or frequency cutoff has ended the sound
+  int sampleCount;   // Number of samples rendered so far
+
+  // Oscillator
+  int phase;
+  int period;
+  double fperiod;
+  double fslide;
+  float squareDuty;
+
+  // Envelope
+  int envStage;
+  int envTime;
+  float envVolume;
+
+  // Filters
+  float fltp;
+  float fltdp;
+  float fltw;
+  float fltphp;
+  float flthp;
+
+  // Vibrato
+  float vibratoPhase;
+
+  // Repeat and arpeggio
+  int repeatTime;
+  int arpeggioTime;
+  int arpeggioLimit;
+
+  // Phaser
+  float fphase;
+  int iphase;
+  int ipp;
+
+  // Silence detection
+  int audible;    // Set once a sample has reached silenceThreshold
+  int quietTime;  // Samples below silenceThreshold since then
+
+  int pinkI;
+  float noiseBuffer[32];    // Random values for SFX_NOISE/SFX_PINK_NOISE
+  float pinkWhiteValue[5];  // SFX_PINK_NOISE
+  float phaserBuffer[4096];  // Room for PNTR_APP_SFX_MAX_SAMPLE_RATE
+
+  SfxProfile profile;  // Counters since pntr_app_sfx_begin_render(), in PNTR_APP_SFX_PROFILE builds
+} SfxSynthState;
+
 typedef struct SfxSynth {
   int sampleFormat;
-  int sampleRate;   // Must be 44100 for now
+  int sampleRate;   // Any rate, the time constants are scaled from 44100
   int maxDuration;  // Length in seconds
+  int maxSamples;   // Length in samples, sampleRate * maxDuration is used when 0
+  int supersample;  // Sub-samples per sample: 1, 2, 4, 8 (the default) or 16
   union {
     uint8_t* u8;
     int16_t* i16;
     float* f;
-  } samples;                // sampleRate * maxDuration
-  float noiseBuffer[32];    // Random values for SFX_NOISE/SFX_PINK_NOISE
-  float pinkWhiteValue[5];  // SFX_PINK_NOISE
-  float phaserBuffer[1024];
+  } samples;  // maxSamples, or sampleRate * maxDuration
+  SfxSynthState state;
 } SfxSynth;
 
+// A rendered sound, as a complete WAV file in memory.
+typedef struct SfxWave {
+  int sampleFormat;      // Set by the caller before rendering (SFX_U8 when zeroed)
+  int supersample;       // Set by the caller, like sampleFormat (8 when zeroed)
+  int sampleRate;        // Set by the caller, like sampleFormat (44100 when zeroed)
+  int sampleCount;
+  unsigned char* data;   // RIFF_header followed by the samples, NULL if rendering failed
+  size_t size;           // Bytes in data
+  uint64_t renderNs;     // Time spent rendering this sound
+} SfxWave;
+
+// Packed sound bank file: a header, count entries sorted by name, then the
+// SfxParams records and the optional pre-rendered WAV files they point to.
+// All values are little-endian, offsets are from the start of the file.
+#define SFX_BANK_NAME_LENGTH 32
+
+typedef struct SfxBankHeader {
+  char signature[4];  // "rFXB"
+  uint16_t version;   // 100
+  uint16_t entrySize; // sizeof(SfxBankEntry)
+  uint32_t count;
+  uint32_t reserved;
+} SfxBankHeader;
+
+typedef struct SfxBankEntry {
+  char name[SFX_BANK_NAME_LENGTH];  // NUL-padded
+  uint32_t paramsOffset;            // SfxParams record
+  uint32_t waveOffset;              // Pre-rendered 8-bit WAV file, 0 for none
+  uint32_t waveSize;
+  uint32_t reserved;
+} SfxBankEntry;
+
+typedef struct SfxBank {
+  int count;
+  const unsigned char* data;  // The whole bank file
+  size_t size;
+  int storage;                // How data is held: borrowed, loaded or mapped
+  pntr_sound** sounds;        // Sounds resolved so far, by id
+  size_t bytes;               // Wave data of the sounds resolved so far
+} SfxBank;
+
+typedef struct SfxCacheEntry {
+  uint64_t hash;
+  SfxParams params;
+  int sampleFormat;
+  int sampleRate;
+  pntr_sound* sound;
+  size_t bytes;       // Size of the wave data given to the sound
+  int refCount;       // Number of pntr_app_sfx_cache_sound() calls not yet released
+  uint64_t lastUsed;  // Value of SfxCache.clock at the last lookup
+} SfxCacheEntry;
+
+typedef struct SfxCache {
+  size_t maxBytes;  // Unreferenced sounds are evicted above this size, 0 for no limit
+  size_t bytes;     // Wave data held by all cached sounds
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t evictions;
+  uint64_t clock;
+  int count;
+  int capacity;
+  SfxCacheEntry* entries;
+} SfxCache;
+
+// Running totals of the sounds rendered, from pntr_app_sfx_get_stats().
+typedef struct SfxStats {
+  uint64_t renders;     // Whole sounds rendered: generate_wave, sounds and batch items
+  uint64_t samples;     // Samples they rendered
+  uint64_t renderNs;    // Time spent rendering them
+  uint64_t bytes;       // Wave data rendered for sounds
+  size_t bytesHeld;     // Wave data currently held by render caches and sound banks
+  uint64_t cacheHits;   // Over every render cache
+  uint64_t cacheMisses;
+  uint64_t allocations;  // Heap allocations, including WAV data handed to pntr_app
+  uint64_t frees;        // Blocks freed through the allocator
+  size_t bytesAllocated; // Bytes currently allocated through the allocator
+} SfxStats;
+
+// Allocator for the memory the library allocates and frees itself, from
+// pntr_app_sfx_set_allocator().
+typedef struct SfxAllocator {
+  void* (*alloc)(size_t size, void* userData);
+  void (*free)(void* ptr, void* userData);
+  void* userData;
+} SfxAllocator;
+
+// What a trace event is about.
+enum SfxTraceKind {
+  SFX_TRACE_GENERATE_WAVE,  // pntr_app_sfx_generate_wave()
+  SFX_TRACE_SOUND,          // A pntr_sound: pntr_app_sfx_sound(), cache misses and bank sounds
+  SFX_TRACE_BATCH,          // An item of pntr_app_sfx_render_batch(), on its worker thread
+  SFX_TRACE_ASYNC           // A sound from pntr_app_sfx_sound_async(), once it is ready
+};
+
+// A render, as seen by the trace callbacks. The results are 0 in the begin callback.
+typedef struct SfxTraceEvent {
+  int kind;                 // SfxTraceKind
+  const SfxParams* params;  // The sound being rendered
+  int sampleFormat;
+  int sampleRate;
+  int sampleCount;          // Samples rendered
+  size_t bytes;             // Bytes of samples, or of the WAV file for sounds
+  uint64_t renderNs;        // Time spent rendering
+} SfxTraceEvent;
+
+typedef void (*SfxTraceCallback)(const SfxTraceEvent* event, void* userData);
+
+// A voice of the mixer, rendering one sound in real time.
+typedef struct SfxVoice {
+  uint32_t id;     // Handle from pntr_app_sfx_mixer_play(), 0 when the voice is free
+  int priority;    // Voices only steal from equal or lower priorities
+  float gain;
+  SfxSynthState state;
+} SfxVoice;
+
+// Polyphonic mixer: a fixed pool of voices, mixed in float into one stream.
+typedef struct SfxMixer {
+  int sampleRate;
+  int supersample;  // Sub-samples per sample of new voices (8 when 0)
+  float gain;       // Master gain, applied before the final conversion
+  int voiceCount;
+  uint32_t nextId;  // Handles grow with every trigger, so they also give a voice's age
+  SfxVoice* voices;
+} SfxMixer;
+
 void pntr_app_sfx_reset_params(SfxParams* params);
 SfxSynth* pntr_app_sfx_alloc_synth(int format, int sampleRate, int maxDuration);
+SfxSynth* pntr_app_sfx_alloc_synth_samples(int format, int sampleRate, int maxSamples);
+int pntr_app_sfx_sample_count(const SfxParams* params);
+int pntr_app_sfx_sample_count_ex(const SfxParams* params, int sampleRate);
 int pntr_app_sfx_generate_wave(pntr_app* app, SfxSynth*, const SfxParams* params);
 
+// Streaming render functions
+void pntr_app_sfx_begin_render(SfxSynthState* state, const SfxParams* params, int format);
+void pntr_app_sfx_begin_render_ex(SfxSynthState* state, const SfxParams* params, int format, int sampleRate);
+
+// Compiled patches, for sounds that are rendered many times
+void pntr_app_sfx_compile(const SfxParams* params, SfxPatch* patch);
+void pntr_app_sfx_compile_ex(const SfxParams* params, SfxPatch* patch, int sampleRate);
+void pntr_app_sfx_begin_render_patch(SfxSynthState* state, const SfxPatch* patch, int format);
+int pntr_app_sfx_patch_sample_count(const SfxPatch* patch);
+int pntr_app_sfx_render(SfxSynthState* state, void* out, int frames);
+
+// Choose the SIMD level of the render loop (SFX_SIMD_NONE for the scalar path)
+int pntr_app_sfx_get_simd(void);
+int pntr_app_sfx_set_simd(int level);
+
+// Choose between precise and fast sine (SfxMathMode)
+int pntr_app_sfx_get_math(void);
+int pntr_app_sfx_set_math(int mode);
+
+// Choose between 8x supersampling and 1x PolyBLEP oscillators (SfxOscillatorMode)
+int pntr_app_sfx_get_oscillator(void);
+int pntr_app_sfx_set_oscillator(int mode);
+
+// Trim leading silence and end sounds early once they fall silent (off by default)
+void pntr_app_sfx_set_silence(float thresholdDb, float holdSeconds);
+
+// Render statistics and trace callbacks around every whole sound rendered
+void pntr_app_sfx_get_stats(SfxStats* stats);
+void pntr_app_sfx_reset_stats(void);
+void pntr_app_sfx_set_trace(SfxTraceCallback begin, SfxTraceCallback end, void* userData);
+
+// Allocator hooks, and pools that keep released synths and scratch for reuse
+void pntr_app_sfx_set_allocator(const SfxAllocator* allocator);
+SfxSynth* pntr_app_sfx_acquire_synth(int format, int sampleRate, int maxSamples);
+void pntr_app_sfx_release_synth(SfxSynth* synth);
+void pntr_app_sfx_trim_pools(void);
+
+// Counters of every render since the last reset, in PNTR_APP_SFX_PROFILE builds
+void pntr_app_sfx_get_profile(SfxProfile* profile);
+void pntr_app_sfx_reset_profile(void);
+
 // Load/Save functions
 bool pntr_app_sfx_load_params(SfxParams* params, const char* fileName);
 bool pntr_app_sfx_save_params(SfxParams* params, const char* fileName);
+bool pntr_app_sfx_load_params_from_memory(SfxParams* params, const void* data, size_t size);
+
+// Batch loading, without allocating per file
+typedef void (*SfxLoadCallback)(const char* fileName, const SfxParams* params, void* userData);
+int pntr_app_sfx_load_params_files(SfxParams* params, const char* const* fileNames, int count);
+int pntr_app_sfx_load_params_dir(const char* dirPath, SfxLoadCallback callback, void* userData);
 
 // Parameter generator functions
 void pntr_app_sfx_gen_pickup_coin(pntr_app* app, SfxParams* sp);
@@ -131,6 +467,50 @@ void pntr_app_sfx_mutate(pntr_app* app, SfxParams* params, float range, uint32_t
 
 // load a SfxParams as a pntr_sound
 pntr_sound* pntr_app_sfx_sound(pntr_app* app, SfxParams* params);
+pntr_sound* pntr_app_sfx_sound_ex(pntr_app* app, SfxParams* params, int format, int sampleRate);
+
+// Batch rendering, spread over worker threads with PNTR_APP_SFX_ENABLE_THREADS
+int pntr_app_sfx_render_batch(const SfxParams* params, int count, SfxWave* outputs, int threads);
+pntr_sound* pntr_app_sfx_load_wave_sound(SfxWave* wave);
+void pntr_app_sfx_unload_wave(SfxWave* wave);
+
+// Sounds rendered in the background, and handed over on the main thread
+typedef struct SfxAsyncSound SfxAsyncSound;
+typedef void (*SfxSoundCallback)(pntr_sound* sound, void* userData);
+SfxAsyncSound* pntr_app_sfx_sound_async(pntr_app* app, SfxParams* params);
+SfxAsyncSound* pntr_app_sfx_sound_async_ex(pntr_app* app, SfxParams* params, int format, int sampleRate);
+bool pntr_app_sfx_async_ready(SfxAsyncSound* async);
+pntr_sound* pntr_app_sfx_async_sound(SfxAsyncSound* async);
+void pntr_app_sfx_unload_async(SfxAsyncSound* async);
+bool pntr_app_sfx_sound_async_callback(pntr_app* app, SfxParams* params, int format, int sampleRate, SfxSoundCallback callback, void* userData);
+int pntr_app_sfx_update_async(void);
+void pntr_app_sfx_cancel_async(void);
+
+// Packed sound banks, resolved lazily by name or id
+SfxBank* pntr_app_sfx_load_bank(const char* fileName);
+SfxBank* pntr_app_sfx_load_bank_from_memory(const void* data, size_t size);
+void pntr_app_sfx_unload_bank(SfxBank* bank);
+int pntr_app_sfx_bank_find(SfxBank* bank, const char* name);
+bool pntr_app_sfx_bank_params(SfxBank* bank, int id, SfxParams* params);
+pntr_sound* pntr_app_sfx_bank_sound(pntr_app* app, SfxBank* bank, int id);
+bool pntr_app_sfx_save_bank(const char* fileName, const char* const* names, const SfxParams* params, int count, bool prerender);
+
+// Render cache: shared, reference-counted sounds keyed by their parameters
+SfxCache* pntr_app_sfx_load_cache(size_t maxBytes);
+void pntr_app_sfx_unload_cache(SfxCache* cache);
+pntr_sound* pntr_app_sfx_cache_sound(pntr_app* app, SfxCache* cache, SfxParams* params);
+pntr_sound* pntr_app_sfx_cache_sound_ex(pntr_app* app, SfxCache* cache, SfxParams* params, int format, int sampleRate);
+void pntr_app_sfx_cache_release(SfxCache* cache, pntr_sound* sound);
+
+// Polyphonic mixer, rendering voices straight from SfxParams into a stream
+SfxMixer* pntr_app_sfx_load_mixer(int voiceCount, int sampleRate);
+void pntr_app_sfx_unload_mixer(SfxMixer* mixer);
+uint32_t pntr_app_sfx_mixer_play(SfxMixer* mixer, const SfxParams* params, float gain, int priority);
+uint32_t pntr_app_sfx_mixer_play_patch(SfxMixer* mixer, const SfxPatch* patch, float gain, int priority);
+void pntr_app_sfx_mixer_stop(SfxMixer* mixer, uint32_t voice);
+void pntr_app_sfx_mixer_set_gain(SfxMixer* mixer, uint32_t voice, float gain);
+bool pntr_app_sfx_mixer_playing(SfxMixer* mixer, uint32_t voice);
+int pntr_app_sfx_mixer_render(SfxMixer* mixer, void* out, int frames, int format);
 
 #endif  // PNTR_APP_SFX_H__
 
@@ -138,44 +518,539 @@ pntr_sound* pntr_app_sfx_sound(pntr_app* app, SfxParams* params);
 #ifndef PNTR_APP_SFX_IMPLEMENTATION_ONCE
 #define PNTR_APP_SFX_IMPLEMENTATION_ONCE
 
-#ifndef PNTR_POW
-#ifdef PNTR_ENABLE_MATH
-#include <math.h>
-#define PNTR_POW powf
-#else  // PNTR_ENABLE_MATH
-static float _pntr_pow(float base, float exponent) {
-  float result = 1.0f;
-  if (exponent >= 0) {
-    for (int i = 0; i < exponent; i++) {
-      result *= base;
-    }
+// Exact powers, for the small integer exponents the sfxr formulas use.
+static inline float _pntr_app_sfx_square(float x) {
+  return x * x;
+}
+
+static inline float _pntr_app_sfx_cube(float x) {
+  return x * x * x;
+}
+
+static inline float _pntr_app_sfx_pow5(float x) {
+  return x * x * x * x * x;
+}
+
+// sin(2 * PI * t) for t in 0..1, without libm: t is folded into a quarter
+// turn, where the Taylor series up to x^9 is within 4e-6 of the real sine.
+// The vector versions in the oscillator stages follow the same steps.
+#define _SFX_SIN_C1 6.28318531f
+#define _SFX_SIN_C3 -41.3417022f
+#define _SFX_SIN_C5 81.6052493f
+#define _SFX_SIN_C7 -76.7058598f
+#define _SFX_SIN_C9 42.0586939f
+
+static inline float _pntr_app_sfx_sin_turns(float t) {
+  float x = t - 0.5f;  // sin(2 * PI * t) = -sin(2 * PI * x)
+  float ax = x < 0.0f ? -x : x;
+  float r = 0.5f - ax;  // sin(PI - a) = sin(a)
+  float x2;
+
+  if (r < ax)
+    ax = r;
+  x = x < 0.0f ? -ax : ax;
+  x2 = x * x;
+  return -(x * (_SFX_SIN_C1 + x2 * (_SFX_SIN_C3 + x2 * (_SFX_SIN_C5 + x2 * (_SFX_SIN_C7 + x2 * _SFX_SIN_C9)))));
+}
+
+// sin(x) for x in radians, with _pntr_app_sfx_sin_turns(). Large x lose
+// precision in the float reduction, as the float phase they come from does.
+static inline float _pntr_app_sfx_sin(float x) {
+  float t = x * (1.0f / (2.0f * PNTR_PI));
+  t -= (float)(int)t;
+  if (t < 0.0f)
+    t += 1.0f;
+  return _pntr_app_sfx_sin_turns(t);
+}
+
+#ifdef PNTR_APP_SFX_FAST_MATH
+static int _pntr_app_sfx_math = SFX_MATH_FAST;
+#else
+static int _pntr_app_sfx_math = SFX_MATH_PRECISE;
+#endif
+
+/*
+ * Return the math mode used by new renders.
+ */
+int pntr_app_sfx_get_math(void) {
+  return _pntr_app_sfx_math;
+}
+
+/*
+ * Choose the math mode of new renders. SFX_MATH_FAST computes sine waves and
+ * vibrato with a polynomial instead of PNTR_SINF, which also lets sine waves
+ * use the SIMD oscillator stage. Define PNTR_APP_SFX_FAST_MATH to make it
+ * the default.
+ *
+ * Return the mode that is now active.
+ */
+int pntr_app_sfx_set_math(int mode) {
+  _pntr_app_sfx_math = (mode == SFX_MATH_FAST) ? SFX_MATH_FAST : SFX_MATH_PRECISE;
+  return _pntr_app_sfx_math;
+}
+
+#ifndef PNTR_MEMSET
+#include <string.h>
+#define PNTR_MEMSET memset
+#endif  // PNTR_MEMSET
+
+#ifndef PNTR_MEMCMP
+#include <string.h>
+#define PNTR_MEMCMP memcmp
+#endif  // PNTR_MEMCMP
+
+// Worker threads for pntr_app_sfx_render_batch(), opt-in since they need pthreads.
+#if defined(PNTR_APP_SFX_ENABLE_THREADS) && !defined(__EMSCRIPTEN__)
+#include <pthread.h>
+#define PNTR_APP_SFX_THREADS
+#endif  // PNTR_APP_SFX_ENABLE_THREADS
+
+#include <time.h>
+
+// Directory listing for pntr_app_sfx_load_params_dir()
+#ifndef PNTR_APP_SFX_MAX_PATH
+#define PNTR_APP_SFX_MAX_PATH 1024
+#endif  // PNTR_APP_SFX_MAX_PATH
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <dirent.h>
+#define PNTR_APP_SFX_DIRENT
+#endif  // _WIN32
+
+// Banks are memory-mapped where that is available, and read with
+// pntr_load_file() everywhere else.
+#if !defined(PNTR_APP_SFX_NO_MMAP) && (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PNTR_APP_SFX_MMAP
+#endif  // PNTR_APP_SFX_NO_MMAP
+
+// Monotonic time in nanoseconds, for timing renders.
+static uint64_t _pntr_app_sfx_time_ns(void) {
+#if defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#elif defined(TIME_UTC)
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#else
+  return (uint64_t)clock() * (1000000000u / CLOCKS_PER_SEC);
+#endif
+}
+
+// Counters of every render since pntr_app_sfx_reset_profile(). Batch worker
+// threads add to them, so they are locked when threads are enabled.
+static SfxProfile _pntr_app_sfx_profile;
+#ifdef PNTR_APP_SFX_THREADS
+static pthread_mutex_t _pntr_app_sfx_profile_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/*
+ * Copy the counters of every render since the last pntr_app_sfx_reset_profile().
+ * The counters of a single render state are in state->profile. Without
+ * PNTR_APP_SFX_PROFILE nothing is counted, and they are all zero.
+ */
+void pntr_app_sfx_get_profile(SfxProfile* profile) {
+  if (profile == NULL) {
+    return;
+  }
+#ifdef PNTR_APP_SFX_THREADS
+  pthread_mutex_lock(&_pntr_app_sfx_profile_lock);
+#endif
+  *profile = _pntr_app_sfx_profile;
+#ifdef PNTR_APP_SFX_THREADS
+  pthread_mutex_unlock(&_pntr_app_sfx_profile_lock);
+#endif
+}
+
+/*
+ * Zero the counters returned by pntr_app_sfx_get_profile().
+ */
+void pntr_app_sfx_reset_profile(void) {
+#ifdef PNTR_APP_SFX_THREADS
+  pthread_mutex_lock(&_pntr_app_sfx_profile_lock);
+#endif
+  PNTR_MEMSET(&_pntr_app_sfx_profile, 0, sizeof(SfxProfile));
+#ifdef PNTR_APP_SFX_THREADS
+  pthread_mutex_unlock(&_pntr_app_sfx_profile_lock);
+#endif
+}
+
+#ifdef PNTR_APP_SFX_PROFILE
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+// Cheap timestamp for the stage counters: the cycle counter on x86 and
+// AArch64, and _pntr_app_sfx_time_ns() everywhere else.
+static inline uint64_t _pntr_app_sfx_ticks(void) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  return __rdtsc();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+  return __rdtsc();
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+  uint64_t ticks;
+  __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  return _pntr_app_sfx_time_ns();
+#endif
+}
+
+// Add the counters of profile to total. SfxProfile only holds uint64_t counters.
+static void _pntr_app_sfx_profile_add(SfxProfile* total, const SfxProfile* profile) {
+  uint64_t* to = (uint64_t*)total;
+  const uint64_t* from = (const uint64_t*)profile;
+  size_t i;
+
+  for (i = 0; i < sizeof(SfxProfile) / sizeof(uint64_t); i++) {
+    to[i] += from[i];
+  }
+}
+
+// Charge the time since the last mark to stage.
+#define _SFX_PROFILE_MARK(stage)                     \
+  do {                                               \
+    uint64_t _sfxNow = _pntr_app_sfx_ticks();        \
+    profile.ticks[(stage)] += _sfxNow - profileTick; \
+    profileTick = _sfxNow;                           \
+  } while (0)
+#define _SFX_PROFILE_COUNT(counter, n) (profile.counter += (uint64_t)(n))
+#else
+#define _SFX_PROFILE_MARK(stage)
+#define _SFX_PROFILE_COUNT(counter, n)
+#endif  // PNTR_APP_SFX_PROFILE
+
+// Render statistics, and the trace callbacks. Batch and async worker threads
+// update the statistics and read the callbacks too, so both are locked when
+// threads are enabled.
+static SfxStats _pntr_app_sfx_stats;
+static SfxTraceCallback _pntr_app_sfx_trace_begin = NULL;
+static SfxTraceCallback _pntr_app_sfx_trace_end = NULL;
+static void* _pntr_app_sfx_trace_data = NULL;
+#ifdef PNTR_APP_SFX_THREADS
+static pthread_mutex_t _pntr_app_sfx_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+#define _SFX_STATS_LOCK() pthread_mutex_lock(&_pntr_app_sfx_stats_lock)
+#define _SFX_STATS_UNLOCK() pthread_mutex_unlock(&_pntr_app_sfx_stats_lock)
+#else
+#define _SFX_STATS_LOCK()
+#define _SFX_STATS_UNLOCK()
+#endif
+
+/*
+ * Copy the render statistics gathered since the last pntr_app_sfx_reset_stats().
+ * They are always kept, at the cost of two clock reads per sound.
+ */
+void pntr_app_sfx_get_stats(SfxStats* stats) {
+  if (stats == NULL) {
+    return;
+  }
+  _SFX_STATS_LOCK();
+  *stats = _pntr_app_sfx_stats;
+  _SFX_STATS_UNLOCK();
+}
+
+/*
+ * Zero the render statistics, except bytesHeld and bytesAllocated, which
+ * follow what is held right now.
+ */
+void pntr_app_sfx_reset_stats(void) {
+  size_t bytesHeld, bytesAllocated;
+
+  _SFX_STATS_LOCK();
+  bytesHeld = _pntr_app_sfx_stats.bytesHeld;
+  bytesAllocated = _pntr_app_sfx_stats.bytesAllocated;
+  PNTR_MEMSET(&_pntr_app_sfx_stats, 0, sizeof(SfxStats));
+  _pntr_app_sfx_stats.bytesHeld = bytesHeld;
+  _pntr_app_sfx_stats.bytesAllocated = bytesAllocated;
+  _SFX_STATS_UNLOCK();
+}
+
+/*
+ * Call begin before and end after every whole sound is rendered, like for a
+ * frame profiler. Either can be NULL. Batch and async sounds are traced on
+ * the worker thread rendering them, so the callbacks must be thread-safe.
+ * Streaming renders and mixer voices are not traced.
+ *
+ * This can be called while other threads render: a sound already under way
+ * may still end with the new end callback, but each callback is always
+ * called with the userData it was set with.
+ */
+void pntr_app_sfx_set_trace(SfxTraceCallback begin, SfxTraceCallback end, void* userData) {
+  _SFX_STATS_LOCK();
+  _pntr_app_sfx_trace_begin = begin;
+  _pntr_app_sfx_trace_end = end;
+  _pntr_app_sfx_trace_data = userData;
+  _SFX_STATS_UNLOCK();
+}
+
+// Start timing a whole render, and tell the begin callback about it.
+static uint64_t _pntr_app_sfx_trace_start(SfxTraceEvent* event, int kind, const SfxParams* params, int sampleFormat, int sampleRate) {
+  SfxTraceCallback begin;
+  void* userData;
+
+  _SFX_STATS_LOCK();
+  begin = _pntr_app_sfx_trace_begin;
+  userData = _pntr_app_sfx_trace_data;
+  _SFX_STATS_UNLOCK();
+
+  event->kind = kind;
+  event->params = params;
+  event->sampleFormat = sampleFormat;
+  event->sampleRate = sampleRate;
+  event->sampleCount = 0;
+  event->bytes = 0;
+  event->renderNs = 0;
+  if (begin != NULL) {
+    begin(event, userData);
+  }
+  return _pntr_app_sfx_time_ns();
+}
+
+// Add a finished render to the statistics, and tell the end callback about it.
+static void _pntr_app_sfx_trace_finish(SfxTraceEvent* event, uint64_t start, int sampleCount, size_t bytes) {
+  SfxTraceCallback end;
+  void* userData;
+
+  event->renderNs = _pntr_app_sfx_time_ns() - start;
+  event->sampleCount = sampleCount;
+  event->bytes = bytes;
+
+  _SFX_STATS_LOCK();
+  _pntr_app_sfx_stats.renders++;
+  _pntr_app_sfx_stats.samples += (uint64_t)sampleCount;
+  _pntr_app_sfx_stats.renderNs += event->renderNs;
+  if (event->kind != SFX_TRACE_GENERATE_WAVE) {
+    _pntr_app_sfx_stats.bytes += bytes;
+  }
+  end = _pntr_app_sfx_trace_end;
+  userData = _pntr_app_sfx_trace_data;
+  _SFX_STATS_UNLOCK();
+
+  // Called outside the lock, so the callbacks can read the statistics.
+  if (end != NULL) {
+    end(event, userData);
+  }
+}
+
+// Memory the library allocates and frees itself goes through the allocator.
+// WAV data given to pntr_app stays on PNTR_MALLOC, since pntr_app frees it.
+// Worker threads allocate too, so it is read and written under the stats lock.
+static SfxAllocator _pntr_app_sfx_allocator = {NULL, NULL, NULL};
+
+// Each block starts with its size, so frees are counted in bytes and pooled
+// blocks know their capacity, and with the allocator that made it, so it is
+// freed there even after pntr_app_sfx_set_allocator() switched to another.
+typedef struct _SfxBlock {
+  size_t size;
+  void (*free)(void* ptr, void* userData);  // NULL for PNTR_FREE
+  void* userData;
+} _SfxBlock;
+
+// Room for _SfxBlock, in a multiple of 16 bytes to keep the block aligned for any type.
+#define _SFX_BLOCK_HEADER ((sizeof(_SfxBlock) + 15) & ~(size_t)15)
+
+static void* _pntr_app_sfx_malloc(size_t size) {
+  SfxAllocator allocator;
+  unsigned char* block;
+  _SfxBlock* header;
+
+  // A copy, so alloc, free and userData always come from the same allocator.
+  _SFX_STATS_LOCK();
+  allocator = _pntr_app_sfx_allocator;
+  _SFX_STATS_UNLOCK();
+
+  if (allocator.alloc != NULL) {
+    block = (unsigned char*)allocator.alloc(_SFX_BLOCK_HEADER + size, allocator.userData);
+  } else {
+    block = (unsigned char*)PNTR_MALLOC(_SFX_BLOCK_HEADER + size);
+  }
+  if (block == NULL) {
+    return NULL;
+  }
+  header = (_SfxBlock*)block;
+  header->size = size;
+  header->free = allocator.free;
+  header->userData = allocator.userData;
+
+  _SFX_STATS_LOCK();
+  _pntr_app_sfx_stats.allocations++;
+  _pntr_app_sfx_stats.bytesAllocated += size;
+  _SFX_STATS_UNLOCK();
+  return block + _SFX_BLOCK_HEADER;
+}
+
+static void _pntr_app_sfx_free(void* ptr) {
+  _SfxBlock* header;
+
+  if (ptr == NULL) {
+    return;
+  }
+  header = (_SfxBlock*)((unsigned char*)ptr - _SFX_BLOCK_HEADER);
+
+  _SFX_STATS_LOCK();
+  _pntr_app_sfx_stats.frees++;
+  _pntr_app_sfx_stats.bytesAllocated -= header->size;
+  _SFX_STATS_UNLOCK();
+
+  if (header->free != NULL) {
+    header->free(header, header->userData);
   } else {
-    for (int i = 0; i > exponent; i--) {
-      result /= base;
+    PNTR_FREE(header);
+  }
+}
+
+// Count an allocation made with PNTR_MALLOC, for WAV data given to pntr_app.
+static void _pntr_app_sfx_count_allocation(void) {
+  _SFX_STATS_LOCK();
+  _pntr_app_sfx_stats.allocations++;
+  _SFX_STATS_UNLOCK();
+}
+
+// Released blocks kept for reuse, per kind of block.
+#ifndef PNTR_APP_SFX_POOL_SIZE
+#define PNTR_APP_SFX_POOL_SIZE 8
+#endif
+
+typedef struct _SfxPool {
+  void* blocks[PNTR_APP_SFX_POOL_SIZE];
+  int count;
+} _SfxPool;
+
+static _SfxPool _pntr_app_sfx_synth_pool;  // SfxSynth and its samples
+static _SfxPool _pntr_app_sfx_state_pool;  // Scratch SfxSynthState of batch workers
+static _SfxPool _pntr_app_sfx_async_pool;  // SfxAsyncSound
+#ifdef PNTR_APP_SFX_THREADS
+static pthread_mutex_t _pntr_app_sfx_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#define _SFX_POOL_LOCK() pthread_mutex_lock(&_pntr_app_sfx_pool_lock)
+#define _SFX_POOL_UNLOCK() pthread_mutex_unlock(&_pntr_app_sfx_pool_lock)
+#else
+#define _SFX_POOL_LOCK()
+#define _SFX_POOL_UNLOCK()
+#endif
+
+// Take a pooled block of at least size bytes, or allocate a new one.
+static void* _pntr_app_sfx_pool_take(_SfxPool* pool, size_t size) {
+  void* block;
+  int i;
+
+  _SFX_POOL_LOCK();
+  for (i = 0; i < pool->count; i++) {
+    block = pool->blocks[i];
+    if (((_SfxBlock*)((unsigned char*)block - _SFX_BLOCK_HEADER))->size >= size) {
+      pool->blocks[i] = pool->blocks[--pool->count];
+      _SFX_POOL_UNLOCK();
+      return block;
     }
   }
-  return result;
+  _SFX_POOL_UNLOCK();
+  return _pntr_app_sfx_malloc(size);
+}
+
+// Keep a block for reuse, or free it if the pool is full.
+static void _pntr_app_sfx_pool_give(_SfxPool* pool, void* block) {
+  if (block == NULL) {
+    return;
+  }
+
+  _SFX_POOL_LOCK();
+  if (pool->count < PNTR_APP_SFX_POOL_SIZE) {
+    pool->blocks[pool->count++] = block;
+    block = NULL;
+  }
+  _SFX_POOL_UNLOCK();
+  _pntr_app_sfx_free(block);
+}
+
+static void _pntr_app_sfx_pool_trim(_SfxPool* pool) {
+  _SFX_POOL_LOCK();
+  while (pool->count > 0) {
+    _pntr_app_sfx_free(pool->blocks[--pool->count]);
+  }
+  _SFX_POOL_UNLOCK();
+}
+
+/*
+ * Free the synths and scratch space kept for reuse.
+ */
+void pntr_app_sfx_trim_pools(void) {
+  _pntr_app_sfx_pool_trim(&_pntr_app_sfx_synth_pool);
+  _pntr_app_sfx_pool_trim(&_pntr_app_sfx_state_pool);
+  _pntr_app_sfx_pool_trim(&_pntr_app_sfx_async_pool);
+}
+
+/*
+ * Allocate the memory the library allocates and frees itself through
+ * allocator, like a frame arena: caches, banks, mixers, pooled synths,
+ * background renders and batch scratch space. Pass NULL to go back to
+ * PNTR_MALLOC and PNTR_FREE.
+ *
+ * It can be switched at any time, even while batch or background renders
+ * run on other threads: the switch is locked, and each block remembers the
+ * allocator that made it and is freed there. Blocks those threads allocate
+ * during the switch come from either allocator. The pools are emptied
+ * first, so later blocks come from the new allocator. Both allocators must
+ * be thread-safe when threads are enabled. WAV data for pntr_app and
+ * pntr_app_sfx_alloc_synth() always use PNTR_MALLOC, since pntr_app and
+ * callers free() them.
+ */
+void pntr_app_sfx_set_allocator(const SfxAllocator* allocator) {
+  pntr_app_sfx_trim_pools();
+  _SFX_STATS_LOCK();
+  if (allocator != NULL && allocator->alloc != NULL && allocator->free != NULL) {
+    _pntr_app_sfx_allocator = *allocator;
+  } else {
+    _pntr_app_sfx_allocator.alloc = NULL;
+    _pntr_app_sfx_allocator.free = NULL;
+    _pntr_app_sfx_allocator.userData = NULL;
+  }
+  _SFX_STATS_UNLOCK();
+}
+
+// xorshift32. The state must never be 0, see _pntr_app_sfx_seed_rand().
+static inline uint32_t _pntr_app_sfx_rand(uint32_t* rng) {
+  uint32_t x = *rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *rng = x;
+  return x;
+}
+
+// Turn a seed (randSeed) into a generator state.
+static uint32_t _pntr_app_sfx_seed_rand(uint32_t seed) {
+  seed = (seed ^ 0x9E3779B9u) * 0x85EBCA6Bu;
+  seed ^= seed >> 16;
+  return seed ? seed : 0x9E3779B9u;
 }
-#define PNTR_POW(x, y) _pntr_pow((x), (y))
-#endif  // PNTR_ENABLE_MATH
-#endif  // PNTR_POW
 
-static int sfx_random(pntr_app* app, int range) {
-  return pntr_app_random(app, 0, range);
+// Return int in the range 0 to range (both inclusive).
+static int sfx_random(uint32_t* rng, int range) {
+  return (int)(_pntr_app_sfx_rand(rng) % (uint32_t)(range + 1));
 }
 
 // Return float in the range 0.0 to 1.0 (both inclusive).
-static float frnd(pntr_app* app, float range) {
-  return pntr_app_random_float(app, 0.0f, range);
+static float frnd(uint32_t* rng, float range) {
+  return (float)(_pntr_app_sfx_rand(rng) >> 8) / 16777215.0f * range;
 }
 
 // Return float in the range -1.0 to 1.0 (both inclusive).
-static float rndNP1(pntr_app* app) {
-  return pntr_app_random_float(app, 0.0f, 1.0f);
+static float rndNP1(uint32_t* rng) {
+  return frnd(rng, 1.0f);
 }
 
 // Return -1.0 to 1.0.
-static float pinkValue(pntr_app* app, int* pinkI, float* whiteValue) {
+static float pinkValue(uint32_t* rng, int* pinkI, float* whiteValue) {
   float sum = 0.0;
   int bitsChanged;
   int lastI = *pinkI;
@@ -188,7 +1063,7 @@ static float pinkValue(pntr_app* app, int* pinkI, float* whiteValue) {
 
   for (i = 0; i < PINK_SIZE; ++i) {
     if (bitsChanged & (1 << i)) {
-      whiteValue[i] = frnd(app, 1.0f);
+      whiteValue[i] = frnd(rng, 1.0f);
     }
     sum += whiteValue[i];
   }
@@ -250,69 +1125,678 @@ void pntr_app_sfx_reset_params(SfxParams* sp) {
  * SfxSynth struct and buffer.
  */
 SfxSynth* pntr_app_sfx_alloc_synth(int format, int sampleRate, int maxDuration) {
-  SfxSynth* syn;
-  size_t bufLen = sampleRate * maxDuration;
+  SfxSynth* syn = pntr_app_sfx_alloc_synth_samples(format, sampleRate, sampleRate * maxDuration);
+  if (syn) {
+    syn->maxDuration = maxDuration;
+    syn->maxSamples = 0;
+  }
+  return syn;
+}
+
+// Bytes of a synth with room for maxSamples samples, behind the struct.
+static size_t _pntr_app_sfx_synth_size(int format, int maxSamples) {
+  size_t bufLen = maxSamples;
 
   if (format == SFX_I16) {
     bufLen *= sizeof(int16_t);
   } else if (format == SFX_F32) {
     bufLen *= sizeof(float);
   }
+  return sizeof(SfxSynth) + bufLen;
+}
+
+// Whether a synth can be made for these arguments. Sets the error when not.
+static bool _pntr_app_sfx_check_synth_args(int format, int sampleRate, int maxSamples) {
+  if (format < SFX_U8 || format > SFX_F32 || sampleRate <= 0 || sampleRate > PNTR_APP_SFX_MAX_SAMPLE_RATE || maxSamples < 0) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return false;
+  }
+  return true;
+}
 
-  syn = (SfxSynth*)PNTR_MALLOC(sizeof(SfxSynth) + bufLen);
+static SfxSynth* _pntr_app_sfx_init_synth(SfxSynth* syn, int format, int sampleRate, int maxSamples) {
   if (syn) {
     syn->sampleFormat = format;
     syn->sampleRate = sampleRate;
-    syn->maxDuration = maxDuration;
+    syn->maxDuration = (maxSamples + sampleRate - 1) / sampleRate;
+    syn->maxSamples = maxSamples;
+    syn->supersample = 8;
     syn->samples.f = (float*)(syn + 1);
   }
   return syn;
 }
 
 /*
- * Synthesize wave data from parameters.
- * A 44100Hz, mono channel wave is generated.
- *
- * Return the number of samples generated.
+ * Like pntr_app_sfx_alloc_synth(), with the buffer length given in samples.
+ * Use pntr_app_sfx_sample_count() to allocate just enough for a sound.
+ * Returns NULL for an unknown format or a sample rate outside
+ * 1..PNTR_APP_SFX_MAX_SAMPLE_RATE.
  */
-int pntr_app_sfx_generate_wave(pntr_app* app, SfxSynth* synth, const SfxParams* sp) {
-  float* phaserBuffer = synth->phaserBuffer;
-  float* noiseBuffer = synth->noiseBuffer;
-  int phase = 0;
-  double fperiod;
-  double fmaxperiod;
-  double fslide;
-  double fdslide;
-  int period;
-  float squareDuty;
-  float squareSlide;
-  int envStage;
-  int envTime;
-  int envLength[3];
-  float envVolume;
-  float fphase;
-  float fdphase;
-  int iphase;
-  int ipp;
-  float fltp;
-  float fltdp;
-  float fltw;
-  float fltwd;
-  float fltdmp;
-  float fltphp;
-  float flthp;
-  float flthpd;
-  float vibratoPhase;
-  float vibratoSpeed;
-  float vibratoAmplitude;
-  int repeatTime;
-  int repeatLimit;
-  int arpeggioTime;
-  int arpeggioLimit;
-  double arpeggioModulation;
-  float minFreq, sslide;
-  int pinkI;
-  int i, sampleCount;
+SfxSynth* pntr_app_sfx_alloc_synth_samples(int format, int sampleRate, int maxSamples) {
+  SfxSynth* syn;
+
+  if (!_pntr_app_sfx_check_synth_args(format, sampleRate, maxSamples)) {
+    return NULL;
+  }
+
+  syn = (SfxSynth*)PNTR_MALLOC(_pntr_app_sfx_synth_size(format, maxSamples));
+  if (syn == NULL) {
+    pntr_set_error(PNTR_ERROR_NO_MEMORY);
+    return NULL;
+  }
+  return _pntr_app_sfx_init_synth(syn, format, sampleRate, maxSamples);
+}
+
+/*
+ * Like pntr_app_sfx_alloc_synth_samples(), but reuse a synth given back with
+ * pntr_app_sfx_release_synth() when one is big enough, so rendering many
+ * sounds does not allocate each time. Give it back with
+ * pntr_app_sfx_release_synth(), not free().
+ */
+SfxSynth* pntr_app_sfx_acquire_synth(int format, int sampleRate, int maxSamples) {
+  SfxSynth* syn;
+
+  if (!_pntr_app_sfx_check_synth_args(format, sampleRate, maxSamples)) {
+    return NULL;
+  }
+
+  syn = (SfxSynth*)_pntr_app_sfx_pool_take(&_pntr_app_sfx_synth_pool, _pntr_app_sfx_synth_size(format, maxSamples));
+  if (syn == NULL) {
+    pntr_set_error(PNTR_ERROR_NO_MEMORY);
+    return NULL;
+  }
+  return _pntr_app_sfx_init_synth(syn, format, sampleRate, maxSamples);
+}
+
+/*
+ * Give a synth from pntr_app_sfx_acquire_synth() back to the pool. Up to
+ * PNTR_APP_SFX_POOL_SIZE synths are kept, the rest are freed.
+ */
+void pntr_app_sfx_release_synth(SfxSynth* synth) {
+  _pntr_app_sfx_pool_give(&_pntr_app_sfx_synth_pool, synth);
+}
+
+// Fill 8 sub-samples of a pitched waveform for phases phase+1 .. phase+8.
+// Callers make sure the phase does not wrap within those 8 sub-samples.
+// Sine waves only come here in fast math mode, so they use the polynomial.
+typedef void (*_SfxOscillateFunc)(int waveType, int phase, int period, float squareDuty, float* out);
+
+#define RAMP(v, x1, x2, y1, y2) (y1 + (y2 - y1) * ((v - x1) / (x2 - x1)))
+
+// Base waveform of a pitched wave type at phase position fp (0..1).
+static inline float _pntr_app_sfx_wave(int waveType, float fp, float squareDuty) {
+  switch (waveType) {
+    case SFX_SQUARE:
+      return (fp < squareDuty) ? 0.5f : -0.5f;
+    case SFX_SAWTOOTH:
+#ifdef SAWTOOTH_DUTY
+      return (fp < squareDuty) ? -1.0f + 2.0f * fp / squareDuty : 1.0f - 2.0f * (fp - squareDuty) / (1.0f - squareDuty);
+#else
+      return 1.0f - fp * 2;
+#endif
+    case SFX_SINE:
+      return PNTR_SINF(fp * 2 * PNTR_PI);
+    case SFX_TRIANGLE:
+      return (fp < 0.5) ? RAMP(fp, 0.0f, 0.5f, -1.0f, 1.0f) : RAMP(fp, 0.5f, 1.0f, 1.0f, -1.0f);
+  }
+  return 0.0f;
+}
+
+static void _pntr_app_sfx_oscillate_scalar(int waveType, int phase, int period, float squareDuty, float* out) {
+  int si;
+
+  for (si = 0; si < 8; si++) {
+    if (waveType == SFX_SINE)
+      out[si] = _pntr_app_sfx_sin_turns((float)(phase + si + 1) / period);
+    else
+      out[si] = _pntr_app_sfx_wave(waveType, (float)(phase + si + 1) / period, squareDuty);
+  }
+}
+
+#ifndef PNTR_APP_SFX_DISABLE_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PNTR_APP_SFX_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define PNTR_APP_SFX_AVX
+#include <immintrin.h>
+#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define PNTR_APP_SFX_NEON
+#include <arm_neon.h>
+#endif
+#endif  // PNTR_APP_SFX_DISABLE_SIMD
+
+// The vector stages below use the same operations in the same order as
+// _pntr_app_sfx_wave(), so they produce bit-identical samples.
+
+#ifdef PNTR_APP_SFX_SSE2
+static inline __m128 _pntr_app_sfx_select_sse2(__m128 mask, __m128 a, __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128 _pntr_app_sfx_sin_turns_sse2(__m128 t) {
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  __m128 x = _mm_sub_ps(t, _mm_set1_ps(0.5f));
+  __m128 negative = _mm_cmplt_ps(x, _mm_setzero_ps());
+  __m128 ax = _mm_andnot_ps(sign, x);
+  __m128 x2;
+
+  ax = _mm_min_ps(ax, _mm_sub_ps(_mm_set1_ps(0.5f), ax));
+  x = _mm_or_ps(ax, _mm_and_ps(negative, sign));
+  x2 = _mm_mul_ps(x, x);
+  x2 = _mm_add_ps(_mm_set1_ps(_SFX_SIN_C1), _mm_mul_ps(x2, _mm_add_ps(_mm_set1_ps(_SFX_SIN_C3), _mm_mul_ps(x2, _mm_add_ps(_mm_set1_ps(_SFX_SIN_C5), _mm_mul_ps(x2, _mm_add_ps(_mm_set1_ps(_SFX_SIN_C7), _mm_mul_ps(x2, _mm_set1_ps(_SFX_SIN_C9)))))))));
+  return _mm_xor_ps(_mm_mul_ps(x, x2), sign);
+}
+
+static void _pntr_app_sfx_oscillate_sse2(int waveType, int phase, int period, float squareDuty, float* out) {
+  const __m128 rperiod = _mm_set1_ps((float)period);
+  const __m128 duty = _mm_set1_ps(squareDuty);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  __m128i phases = _mm_add_epi32(_mm_set1_epi32(phase), _mm_setr_epi32(1, 2, 3, 4));
+  int si;
+
+  for (si = 0; si < 8; si += 4) {
+    __m128 fp = _mm_div_ps(_mm_cvtepi32_ps(phases), rperiod);
+    __m128 sample;
+
+    switch (waveType) {
+      case SFX_SQUARE:
+        sample = _pntr_app_sfx_select_sse2(_mm_cmplt_ps(fp, duty), half, _mm_set1_ps(-0.5f));
+        break;
+      case SFX_SAWTOOTH:
+#ifdef SAWTOOTH_DUTY
+        sample = _pntr_app_sfx_select_sse2(_mm_cmplt_ps(fp, duty),
+                                           _mm_add_ps(_mm_set1_ps(-1.0f), _mm_div_ps(_mm_mul_ps(two, fp), duty)),
+                                           _mm_sub_ps(one, _mm_div_ps(_mm_mul_ps(two, _mm_sub_ps(fp, duty)), _mm_sub_ps(one, duty))));
+#else
+        sample = _mm_sub_ps(one, _mm_mul_ps(fp, two));
+#endif
+        break;
+      case SFX_TRIANGLE:
+        sample = _pntr_app_sfx_select_sse2(_mm_cmplt_ps(fp, half),
+                                           _mm_add_ps(_mm_set1_ps(-1.0f), _mm_mul_ps(two, _mm_div_ps(fp, half))),
+                                           _mm_add_ps(one, _mm_mul_ps(_mm_set1_ps(-2.0f), _mm_div_ps(_mm_sub_ps(fp, half), half))));
+        break;
+      case SFX_SINE:
+        sample = _pntr_app_sfx_sin_turns_sse2(fp);
+        break;
+      default:
+        _pntr_app_sfx_oscillate_scalar(waveType, phase, period, squareDuty, out);
+        return;
+    }
+    _mm_storeu_ps(out + si, sample);
+    phases = _mm_add_epi32(phases, _mm_set1_epi32(4));
+  }
+}
+#endif  // PNTR_APP_SFX_SSE2
+
+#ifdef PNTR_APP_SFX_AVX
+__attribute__((target("avx"))) static inline __m256 _pntr_app_sfx_sin_turns_avx(__m256 t) {
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  __m256 x = _mm256_sub_ps(t, _mm256_set1_ps(0.5f));
+  __m256 negative = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ);
+  __m256 ax = _mm256_andnot_ps(sign, x);
+  __m256 x2;
+
+  ax = _mm256_min_ps(ax, _mm256_sub_ps(_mm256_set1_ps(0.5f), ax));
+  x = _mm256_or_ps(ax, _mm256_and_ps(negative, sign));
+  x2 = _mm256_mul_ps(x, x);
+  x2 = _mm256_add_ps(_mm256_set1_ps(_SFX_SIN_C1), _mm256_mul_ps(x2, _mm256_add_ps(_mm256_set1_ps(_SFX_SIN_C3), _mm256_mul_ps(x2, _mm256_add_ps(_mm256_set1_ps(_SFX_SIN_C5), _mm256_mul_ps(x2, _mm256_add_ps(_mm256_set1_ps(_SFX_SIN_C7), _mm256_mul_ps(x2, _mm256_set1_ps(_SFX_SIN_C9)))))))));
+  return _mm256_xor_ps(_mm256_mul_ps(x, x2), sign);
+}
+
+__attribute__((target("avx"))) static void _pntr_app_sfx_oscillate_avx(int waveType, int phase, int period, float squareDuty, float* out) {
+  const __m256i phases = _mm256_setr_epi32(phase + 1, phase + 2, phase + 3, phase + 4, phase + 5, phase + 6, phase + 7, phase + 8);
+  const __m256 fp = _mm256_div_ps(_mm256_cvtepi32_ps(phases), _mm256_set1_ps((float)period));
+  const __m256 duty = _mm256_set1_ps(squareDuty);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  __m256 sample;
+
+  switch (waveType) {
+    case SFX_SQUARE:
+      sample = _mm256_blendv_ps(_mm256_set1_ps(-0.5f), half, _mm256_cmp_ps(fp, duty, _CMP_LT_OQ));
+      break;
+    case SFX_SAWTOOTH:
+#ifdef SAWTOOTH_DUTY
+      sample = _mm256_blendv_ps(_mm256_sub_ps(one, _mm256_div_ps(_mm256_mul_ps(two, _mm256_sub_ps(fp, duty)), _mm256_sub_ps(one, duty))),
+                                _mm256_add_ps(_mm256_set1_ps(-1.0f), _mm256_div_ps(_mm256_mul_ps(two, fp), duty)),
+                                _mm256_cmp_ps(fp, duty, _CMP_LT_OQ));
+#else
+      sample = _mm256_sub_ps(one, _mm256_mul_ps(fp, two));
+#endif
+      break;
+    case SFX_TRIANGLE:
+      sample = _mm256_blendv_ps(_mm256_add_ps(one, _mm256_mul_ps(_mm256_set1_ps(-2.0f), _mm256_div_ps(_mm256_sub_ps(fp, half), half))),
+                                _mm256_add_ps(_mm256_set1_ps(-1.0f), _mm256_mul_ps(two, _mm256_div_ps(fp, half))),
+                                _mm256_cmp_ps(fp, half, _CMP_LT_OQ));
+      break;
+    case SFX_SINE:
+      sample = _pntr_app_sfx_sin_turns_avx(fp);
+      break;
+    default:
+      _pntr_app_sfx_oscillate_scalar(waveType, phase, period, squareDuty, out);
+      return;
+  }
+  _mm256_storeu_ps(out, sample);
+}
+#endif  // PNTR_APP_SFX_AVX
+
+#ifdef PNTR_APP_SFX_NEON
+static inline float32x4_t _pntr_app_sfx_sin_turns_neon(float32x4_t t) {
+  float32x4_t x = vsubq_f32(t, vdupq_n_f32(0.5f));
+  uint32x4_t negative = vcltq_f32(x, vdupq_n_f32(0.0f));
+  float32x4_t ax = vabsq_f32(x);
+  float32x4_t x2;
+
+  ax = vminq_f32(ax, vsubq_f32(vdupq_n_f32(0.5f), ax));
+  x = vbslq_f32(negative, vnegq_f32(ax), ax);
+  x2 = vmulq_f32(x, x);
+  x2 = vaddq_f32(vdupq_n_f32(_SFX_SIN_C1), vmulq_f32(x2, vaddq_f32(vdupq_n_f32(_SFX_SIN_C3), vmulq_f32(x2, vaddq_f32(vdupq_n_f32(_SFX_SIN_C5), vmulq_f32(x2, vaddq_f32(vdupq_n_f32(_SFX_SIN_C7), vmulq_f32(x2, vdupq_n_f32(_SFX_SIN_C9)))))))));
+  return vnegq_f32(vmulq_f32(x, x2));
+}
+
+static void _pntr_app_sfx_oscillate_neon(int waveType, int phase, int period, float squareDuty, float* out) {
+  static const int32_t offsets[4] = {1, 2, 3, 4};
+  const float32x4_t rperiod = vdupq_n_f32((float)period);
+  const float32x4_t duty = vdupq_n_f32(squareDuty);
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  const float32x4_t two = vdupq_n_f32(2.0f);
+  const float32x4_t half = vdupq_n_f32(0.5f);
+  int32x4_t phases = vaddq_s32(vdupq_n_s32(phase), vld1q_s32(offsets));
+  int si;
+
+  for (si = 0; si < 8; si += 4) {
+    float32x4_t fp = vdivq_f32(vcvtq_f32_s32(phases), rperiod);
+    float32x4_t sample;
+
+    switch (waveType) {
+      case SFX_SQUARE:
+        sample = vbslq_f32(vcltq_f32(fp, duty), half, vdupq_n_f32(-0.5f));
+        break;
+      case SFX_SAWTOOTH:
+#ifdef SAWTOOTH_DUTY
+        sample = vbslq_f32(vcltq_f32(fp, duty),
+                           vaddq_f32(vdupq_n_f32(-1.0f), vdivq_f32(vmulq_f32(two, fp), duty)),
+                           vsubq_f32(one, vdivq_f32(vmulq_f32(two, vsubq_f32(fp, duty)), vsubq_f32(one, duty))));
+#else
+        sample = vsubq_f32(one, vmulq_f32(fp, two));
+#endif
+        break;
+      case SFX_TRIANGLE:
+        sample = vbslq_f32(vcltq_f32(fp, half),
+                           vaddq_f32(vdupq_n_f32(-1.0f), vmulq_f32(two, vdivq_f32(fp, half))),
+                           vaddq_f32(one, vmulq_f32(vdupq_n_f32(-2.0f), vdivq_f32(vsubq_f32(fp, half), half))));
+        break;
+      case SFX_SINE:
+        sample = _pntr_app_sfx_sin_turns_neon(fp);
+        break;
+      default:
+        _pntr_app_sfx_oscillate_scalar(waveType, phase, period, squareDuty, out);
+        return;
+    }
+    vst1q_f32(out + si, sample);
+    phases = vaddq_s32(phases, vdupq_n_s32(4));
+  }
+}
+#endif  // PNTR_APP_SFX_NEON
+
+static int _pntr_app_sfx_simd = -1;
+
+// Find the best SIMD level this CPU supports.
+static int _pntr_app_sfx_detect_simd(void) {
+#if defined(PNTR_APP_SFX_AVX)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx"))
+    return SFX_SIMD_AVX;
+#endif
+#if defined(PNTR_APP_SFX_SSE2)
+  return SFX_SIMD_SSE2;
+#elif defined(PNTR_APP_SFX_NEON)
+  return SFX_SIMD_NEON;
+#else
+  return SFX_SIMD_NONE;
+#endif
+}
+
+/*
+ * Return the SIMD level used by the render loop.
+ */
+int pntr_app_sfx_get_simd(void) {
+  if (_pntr_app_sfx_simd < 0)
+    _pntr_app_sfx_simd = _pntr_app_sfx_detect_simd();
+  return _pntr_app_sfx_simd;
+}
+
+/*
+ * Choose the SIMD level used by new renders. Levels the CPU does not
+ * support fall back to the best one it does, and SFX_SIMD_NONE always
+ * selects the scalar path.
+ *
+ * Return the level that is now active.
+ */
+int pntr_app_sfx_set_simd(int level) {
+  int best = _pntr_app_sfx_detect_simd();
+
+  if (level == SFX_SIMD_NONE)
+    _pntr_app_sfx_simd = SFX_SIMD_NONE;
+  else if (level == SFX_SIMD_SSE2 && best == SFX_SIMD_AVX)
+    _pntr_app_sfx_simd = SFX_SIMD_SSE2;
+  else
+    _pntr_app_sfx_simd = best;
+  return _pntr_app_sfx_simd;
+}
+
+// Pick the oscillator stage for a SIMD level.
+static _SfxOscillateFunc _pntr_app_sfx_select_oscillator(int simd) {
+  switch (simd) {
+#ifdef PNTR_APP_SFX_SSE2
+    case SFX_SIMD_SSE2:
+      return _pntr_app_sfx_oscillate_sse2;
+#endif
+#ifdef PNTR_APP_SFX_AVX
+    case SFX_SIMD_AVX:
+      return _pntr_app_sfx_oscillate_avx;
+#endif
+#ifdef PNTR_APP_SFX_NEON
+    case SFX_SIMD_NEON:
+      return _pntr_app_sfx_oscillate_neon;
+#endif
+  }
+  return _pntr_app_sfx_oscillate_scalar;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define _PNTR_APP_SFX_FORCE_INLINE static inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define _PNTR_APP_SFX_FORCE_INLINE static __forceinline
+#else
+#define _PNTR_APP_SFX_FORCE_INLINE static inline
+#endif
+
+// Optional stages of the render loop, see SfxSynthState.kernelFlags.
+#define _SFX_KERNEL_LPF 1       // lpfCutoff is not 1.0
+#define _SFX_KERNEL_PHASER 2    // phaserOffset or phaserSweep is set
+#define _SFX_KERNEL_POLYBLEP 4  // SFX_OSCILLATOR_POLYBLEP: one sub-sample per sample
+
+// Phaser delay line, a power of two so positions wrap with a mask.
+#define _SFX_PHASER_SIZE 4096
+#define _SFX_PHASER_MASK (_SFX_PHASER_SIZE - 1)
+
+// Filter coefficients are scaled by the rate, which below 44100 can take
+// them past where the filters are stable. The low-pass resonator needs its
+// damping under 1 and a bounded coefficient, and the high-pass a decay
+// between 0 and 1, so they are clamped to these.
+#define _SFX_LPF_MAX 1.0f
+#define _SFX_LPF_DAMPING_MAX 0.8f
+#define _SFX_HPF_MAX 1.0f
+
+static int _pntr_app_sfx_oscillator = SFX_OSCILLATOR_SUPERSAMPLE;
+
+/*
+ * Return the oscillator mode used by new renders.
+ */
+int pntr_app_sfx_get_oscillator(void) {
+  return _pntr_app_sfx_oscillator;
+}
+
+/*
+ * Choose the oscillator mode of new renders. SFX_OSCILLATOR_POLYBLEP renders
+ * one band-limited sub-sample per sample instead of 8 box-filtered ones, and
+ * runs the filters 8 steps at a time. It is several times faster, and sounds
+ * close to, but not exactly like, the default. It ignores supersample.
+ *
+ * Return the mode that is now active.
+ */
+int pntr_app_sfx_set_oscillator(int mode) {
+  _pntr_app_sfx_oscillator = (mode == SFX_OSCILLATOR_POLYBLEP) ? SFX_OSCILLATOR_POLYBLEP : SFX_OSCILLATOR_SUPERSAMPLE;
+  return _pntr_app_sfx_oscillator;
+}
+
+static float _pntr_app_sfx_silence_threshold = 0.0f;
+static float _pntr_app_sfx_silence_hold = 0.0f;
+
+// e^x without libm: a Taylor series on x / 256, squared back up 8 times.
+static float _pntr_app_sfx_exp(float x) {
+  float y = x / 256.0f;
+  float r = 1.0f + y * (1.0f + y * (0.5f + y * (1.0f / 6.0f + y * (1.0f / 24.0f))));
+  int i;
+
+  for (i = 0; i < 8; i++)
+    r *= r;
+  return r;
+}
+
+/*
+ * Turn on silence detection for new renders. Samples quieter than
+ * thresholdDb (in dBFS, like -60) are skipped until the sound first
+ * reaches it, and once the attack is over, the sound ends after staying
+ * below it for holdSeconds. A threshold of 0 dBFS or more turns it off.
+ *
+ * Sounds can then be shorter than pntr_app_sfx_sample_count() says.
+ */
+void pntr_app_sfx_set_silence(float thresholdDb, float holdSeconds) {
+  // 10^(dB / 20), with ln(10) / 20
+  _pntr_app_sfx_silence_threshold = (thresholdDb < 0.0f) ? _pntr_app_sfx_exp(thresholdDb * 0.115129255f) : 0.0f;
+  _pntr_app_sfx_silence_hold = (holdSeconds > 0.0f) ? holdSeconds : 0.0f;
+}
+
+// The global settings a render starts with. Renders on worker threads get
+// them from the thread that started them, so they never read the globals.
+typedef struct _SfxModes {
+  int simd;
+  int math;
+  int oscillator;
+  float silenceThreshold;
+  float silenceHold;
+} _SfxModes;
+
+static void _pntr_app_sfx_get_modes(_SfxModes* modes) {
+  modes->simd = pntr_app_sfx_get_simd();
+  modes->math = _pntr_app_sfx_math;
+  modes->oscillator = _pntr_app_sfx_oscillator;
+  modes->silenceThreshold = _pntr_app_sfx_silence_threshold;
+  modes->silenceHold = _pntr_app_sfx_silence_hold;
+}
+
+// PolyBLEP residual of a unit step at t = 0, for a phase step of dt per sample.
+static inline float _pntr_app_sfx_blep(float t, float dt) {
+  if (t < dt) {
+    t /= dt;
+    return t + t - t * t - 1.0f;
+  }
+  if (t > 1.0f - dt) {
+    t = (t - 1.0f) / dt;
+    return t * t + t + t + 1.0f;
+  }
+  return 0.0f;
+}
+
+// PolyBLAMP residual of a unit change of slope at t = 0.
+static inline float _pntr_app_sfx_blamp(float t, float dt) {
+  if (t < dt) {
+    t = t / dt - 1.0f;
+    return -t * t * t / 3.0f;
+  }
+  if (t > 1.0f - dt) {
+    t = (t - 1.0f) / dt + 1.0f;
+    return t * t * t / 3.0f;
+  }
+  return 0.0f;
+}
+
+// Pitched waveform at phase, band-limited for rendering at one sub-sample per
+// sample: steps are smoothed with PolyBLEP and corners with PolyBLAMP.
+static inline float _pntr_app_sfx_blep_wave(int waveType, int phase, int period, float squareDuty, int fastMath) {
+  float fp = (float)phase / period;
+  float dt = 8.0f / period;
+  float sample, corner, slopes;
+
+  switch (waveType) {
+    case SFX_SQUARE:
+      corner = fp - squareDuty;
+      if (corner < 0.0f)
+        corner += 1.0f;
+      sample = _pntr_app_sfx_wave(waveType, fp, squareDuty);
+      return sample + 0.5f * _pntr_app_sfx_blep(fp, dt) - 0.5f * _pntr_app_sfx_blep(corner, dt);
+    case SFX_SAWTOOTH:
+      sample = _pntr_app_sfx_wave(waveType, fp, squareDuty);
+#ifdef SAWTOOTH_DUTY
+      // A rise shorter than a sample is a step.
+      if (squareDuty < dt)
+        return sample + _pntr_app_sfx_blep(fp, dt);
+      corner = fp - squareDuty;
+      if (corner < 0.0f)
+        corner += 1.0f;
+      slopes = 2.0f / squareDuty + 2.0f / (1.0f - squareDuty);
+      return sample + slopes * 0.5f * dt * (_pntr_app_sfx_blamp(fp, dt) - _pntr_app_sfx_blamp(corner, dt));
+#else
+      return sample + _pntr_app_sfx_blep(fp, dt);
+#endif
+    case SFX_SINE:
+      return fastMath ? _pntr_app_sfx_sin_turns(fp) : _pntr_app_sfx_wave(waveType, fp, squareDuty);
+    case SFX_TRIANGLE:
+      corner = fp + 0.5f;
+      if (corner >= 1.0f)
+        corner -= 1.0f;
+      sample = _pntr_app_sfx_wave(waveType, fp, squareDuty);
+      return sample + 4.0f * dt * (_pntr_app_sfx_blamp(fp, dt) - _pntr_app_sfx_blamp(corner, dt));
+  }
+  return 0.0f;
+}
+
+// Round a supersampling factor down to one the render loop supports, 8 for 0.
+static inline int _pntr_app_sfx_supersample(int factor) {
+  if (factor <= 0)
+    return 8;
+  if (factor >= 16)
+    return 16;
+  if (factor >= 8)
+    return 8;
+  if (factor >= 4)
+    return 4;
+  return factor >= 2 ? 2 : 1;
+}
+
+// Run 2^shift steps of the low-pass filter at once. With the input held, the
+// filter's offset from the input decays by its step matrix to that power.
+static inline void _pntr_app_sfx_lpf_steps(float* fltp, float* fltdp, float sample, float fltw, float fltdmp, int shift) {
+  float c = 1.0f - fltdmp;
+  float m11 = 1.0f - fltw * c;
+  float m12 = c;
+  float m21 = -fltw * c;
+  float m22 = c;
+  float t11, t12, t21, t22, dx;
+  int i;
+
+  for (i = 0; i < shift; i++) {
+    t11 = m11 * m11 + m12 * m21;
+    t12 = m11 * m12 + m12 * m22;
+    t21 = m21 * m11 + m22 * m21;
+    t22 = m21 * m12 + m22 * m22;
+    m11 = t11;
+    m12 = t12;
+    m21 = t21;
+    m22 = t22;
+  }
+
+  dx = *fltp - sample;
+  *fltp = sample + m11 * dx + m12 * *fltdp;
+  *fltdp = m21 * dx + m22 * *fltdp;
+}
+
+// How much the high-pass filter decays over 2^shift steps.
+static inline float _pntr_app_sfx_hpf_decay(float flthp, int shift) {
+  float decay = 1.0f - flthp;
+  int i;
+
+  for (i = 0; i < shift; i++)
+    decay *= decay;
+  return decay;
+}
+
+// Restart the oscillator from the patch, on every repeat.
+#define RESET_SAMPLE                      \
+  fperiod = patch->fperiod;               \
+  period = patch->period;                 \
+  fslide = patch->fslide;                 \
+  squareDuty = patch->squareDuty;         \
+  arpeggioTime = 0;                       \
+  arpeggioLimit = patch->arpeggioLimit;
+
+#define RESET_NOISE                                                  \
+  if (waveType == SFX_NOISE) {                                       \
+    for (n = 0; n < 32; n++)                                         \
+      noiseBuffer[n] = rndNP1(&rng);                                 \
+  } else if (waveType == SFX_PINK_NOISE) {                           \
+    for (n = 0; n < 32; n++)                                         \
+      noiseBuffer[n] = pinkValue(&rng, &pinkI, state->pinkWhiteValue); \
+  }
+
+// RESET_NOISE in the render loop, timed as its own stage in profile builds.
+#ifdef PNTR_APP_SFX_PROFILE
+#define _SFX_RENDER_RESET_NOISE                              \
+  if (waveType == SFX_NOISE || waveType == SFX_PINK_NOISE) { \
+    _SFX_PROFILE_MARK(SFX_STAGE_OSCILLATOR);                 \
+    RESET_NOISE                                              \
+    _SFX_PROFILE_MARK(SFX_STAGE_NOISE);                      \
+    _SFX_PROFILE_COUNT(noiseRefills, 1);                     \
+  }
+#else
+#define _SFX_RENDER_RESET_NOISE RESET_NOISE
+#endif
+
+/*
+ * Prepare a render state to synthesize the given parameters.
+ * The parameters are copied, so they do not need to outlive the state.
+ * Noise comes from params->randSeed, so equal params render equal samples.
+ *
+ * Samples are then pulled with pntr_app_sfx_render(). state->supersample
+ * starts at 8, and can be lowered for speed or raised to 16 before then.
+ */
+void pntr_app_sfx_begin_render(SfxSynthState* state, const SfxParams* params, int format) {
+  pntr_app_sfx_begin_render_ex(state, params, format, 44100);
+}
+
+/*
+ * Like pntr_app_sfx_begin_render(), rendering at sampleRate instead of 44100.
+ * Envelope lengths, slides, sweeps and filter coefficients are scaled from
+ * the 44100 that sfxr tunes them for, so a sound keeps its timing and tone.
+ */
+void pntr_app_sfx_begin_render_ex(SfxSynthState* state, const SfxParams* params, int format, int sampleRate) {
+  pntr_app_sfx_compile_ex(params, &state->patch, sampleRate);
+  pntr_app_sfx_begin_render_patch(state, &state->patch, format);
+}
+
+/*
+ * Compile params into a patch for rendering at 44100. Every coefficient the
+ * render loop derives from the parameters is computed here, once.
+ */
+void pntr_app_sfx_compile(const SfxParams* params, SfxPatch* patch) {
+  pntr_app_sfx_compile_ex(params, patch, 44100);
+}
+
+/*
+ * Like pntr_app_sfx_compile(), for rendering at sampleRate. Rates above
+ * PNTR_APP_SFX_MAX_SAMPLE_RATE are not supported: the patch then renders
+ * no samples.
+ */
+void pntr_app_sfx_compile_ex(const SfxParams* params, SfxPatch* patch, int sampleRate) {
+  const SfxParams* sp = params;
+  const double rateScale = (sampleRate > 0 ? sampleRate : 44100) / 44100.0;
+  const float rate = (float)rateScale;
+  float minFreq, sslide, fltw;
+
+  patch->waveType = sp->waveType;
+  patch->randSeed = sp->randSeed;
+  patch->sampleRate = sampleRate > 0 ? sampleRate : 44100;
+  patch->rateScale = rateScale;
+  if (patch->sampleRate > PNTR_APP_SFX_MAX_SAMPLE_RATE)
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
 
   // Sanity check some related parameters.
   minFreq = sp->minFrequency;
@@ -323,97 +1807,259 @@ int pntr_app_sfx_generate_wave(pntr_app* app, SfxSynth* synth, const SfxParams*
   if (sslide < sp->deltaSlide)
     sslide = sp->deltaSlide;
 
-#define RESET_SAMPLE                                                                                                                            \
-  fperiod = 100.0 / (sp->startFrequency * sp->startFrequency + 0.001);                                                                          \
-  period = (int)fperiod;                                                                                                                        \
-  fmaxperiod = 100.0 / (minFreq * minFreq + 0.001);                                                                                             \
-  fslide = 1.0 - PNTR_POW(sslide, 3.0) * 0.01;                                                                                                  \
-  fdslide = -PNTR_POW(sp->deltaSlide, 3.0) * 0.000001;                                                                                          \
-  squareDuty = 0.5f - sp->squareDuty * 0.5f;                                                                                                    \
-  squareSlide = -sp->dutySweep * 0.00005f;                                                                                                      \
-  arpeggioModulation = (sp->changeAmount >= 0.0f) ? 1.0 - PNTR_POW(sp->changeAmount, 2.0) * 0.9 : 1.0 + PNTR_POW(sp->changeAmount, 2.0) * 10.0; \
-  arpeggioTime = 0;                                                                                                                             \
-  arpeggioLimit = (sp->changeSpeed == 1.0f) ? 0 : (int)(PNTR_POW(1.0f - sp->changeSpeed, 2.0f) * 20000 + 32);
+  patch->minFreq = minFreq;
+  patch->fperiod = 100.0 / (sp->startFrequency * sp->startFrequency + 0.001) * rateScale;
+  patch->period = (int)patch->fperiod;
+  patch->fmaxperiod = 100.0 / (minFreq * minFreq + 0.001) * rateScale;
+  patch->fslide = 1.0 - _pntr_app_sfx_cube(sslide) * 0.01 / rateScale;
+  patch->fdslide = -_pntr_app_sfx_cube(sp->deltaSlide) * 0.000001 / (rateScale * rateScale);
+  patch->squareDuty = 0.5f - sp->squareDuty * 0.5f;
+  patch->squareSlide = (float)(-sp->dutySweep * 0.00005f / rateScale);
+  patch->arpeggioModulation = (sp->changeAmount >= 0.0f) ? 1.0 - _pntr_app_sfx_square(sp->changeAmount) * 0.9 : 1.0 + _pntr_app_sfx_square(sp->changeAmount) * 10.0;
+  patch->arpeggioLimit = (sp->changeSpeed == 1.0f) ? 0 : (int)((_pntr_app_sfx_square(1.0f - sp->changeSpeed) * 20000 + 32) * rateScale);
+
+  // Filters. The low-pass is a resonator, so its coefficient scales with the
+  // square of the rate, and its damping and the high-pass with the rate. Low
+  // rates are clamped again after scaling, to keep the filters stable.
+  fltw = _pntr_app_sfx_cube(sp->lpfCutoff) * 0.1f;
+  patch->fltwd = 1.0f + sp->lpfCutoffSweep * 0.0001f / rate;
+  patch->fltdmp = 5.0f / (1.0f + _pntr_app_sfx_square(sp->lpfResonance) * 20.0f) * (0.01f + fltw);
+  if (patch->fltdmp > 0.8f)
+    patch->fltdmp = 0.8f;
+  patch->fltw = fltw / (rate * rate);
+  if (patch->fltw > _SFX_LPF_MAX)
+    patch->fltw = _SFX_LPF_MAX;
+  patch->fltdmp /= rate;
+  if (patch->fltdmp > _SFX_LPF_DAMPING_MAX)
+    patch->fltdmp = _SFX_LPF_DAMPING_MAX;
+  patch->flthp = _pntr_app_sfx_square(sp->hpfCutoff) * 0.1f / rate;
+  if (patch->flthp > _SFX_HPF_MAX)
+    patch->flthp = _SFX_HPF_MAX;
+  patch->flthpd = 1.0f + sp->hpfCutoffSweep * 0.0003f / rate;
+
+  // Vibrato
+  patch->vibratoSpeed = _pntr_app_sfx_square(sp->vibratoSpeed) * 0.01f / rate;
+  patch->vibratoAmplitude = sp->vibratoDepth * 0.5f;
+
+  // Envelope
+  patch->envLength[0] = (int)(sp->attackTime * sp->attackTime * 100000.0f * rateScale);
+  patch->envLength[1] = (int)(sp->sustainTime * sp->sustainTime * 100000.0f * rateScale);
+  patch->envLength[2] = (int)(sp->decayTime * sp->decayTime * 100000.0f * rateScale);
+  patch->sustainPunch = sp->sustainPunch;
+
+  // The phaser delay is in sub-samples, so it grows with the rate, while its
+  // sweep per sample stays the same.
+  patch->fphase = _pntr_app_sfx_square(sp->phaserOffset) * 1020.0f * rate;
+  if (sp->phaserOffset < 0.0f)
+    patch->fphase = -patch->fphase;
 
-  RESET_SAMPLE
+  patch->fdphase = _pntr_app_sfx_square(sp->phaserSweep) * 1.0f;
+  if (sp->phaserSweep < 0.0f)
+    patch->fdphase = -patch->fdphase;
+  patch->phaserLimit = (int)(1023 * rateScale);
+
+  // The shortest period is a pitch, so it is scaled like fperiod above 44100.
+  // Below, 8 sub-samples are already a whole sample, and the PolyBLEP kernel
+  // steps 8 at a time, so the period never gets shorter.
+  patch->minPeriod = (int)(8 * rateScale);
+  if (patch->minPeriod < 8)
+    patch->minPeriod = 8;
+
+  patch->repeatLimit = (int)((_pntr_app_sfx_square(1.0f - sp->repeatSpeed) * 20000 + 32) * rateScale);
+  if (sp->repeatSpeed == 0.0f)
+    patch->repeatLimit = 0;
+
+  // The stages this sound uses
+  patch->kernelFlags = 0;
+  if (sp->lpfCutoff != 1.0f)
+    patch->kernelFlags |= _SFX_KERNEL_LPF;
+  if (patch->fphase != 0.0f || patch->fdphase != 0.0f)
+    patch->kernelFlags |= _SFX_KERNEL_PHASER;
+}
+
+// Like pntr_app_sfx_begin_render_patch(), with the given settings.
+static void _pntr_app_sfx_begin_render_modes(SfxSynthState* state, const SfxPatch* patch, int format, const _SfxModes* modes) {
+  float* noiseBuffer = state->noiseBuffer;
+  int pinkI, waveType, n;
+  uint32_t rng = _pntr_app_sfx_seed_rand(patch->randSeed);
+
+  if (patch != &state->patch)
+    state->patch = *patch;
+  patch = &state->patch;
+
+  state->sampleFormat = format;
+  state->mathMode = modes->math;
+  state->simd = modes->simd;
+  state->supersample = 8;
+  state->finished = patch->sampleRate > PNTR_APP_SFX_MAX_SAMPLE_RATE;
+  state->sampleCount = 0;
+  state->phase = 0;
+
+  waveType = patch->waveType;
+
+  state->fperiod = patch->fperiod;
+  state->period = patch->period;
+  state->fslide = patch->fslide;
+  state->squareDuty = patch->squareDuty;
+  state->arpeggioTime = 0;
+  state->arpeggioLimit = patch->arpeggioLimit;
 
   // Reset filter
-  fltp = fltdp = 0.0f;
-  fltw = PNTR_POW(sp->lpfCutoff, 3.0f) * 0.1f;
-  fltwd = 1.0f + sp->lpfCutoffSweep * 0.0001f;
-  fltdmp = 5.0f / (1.0f + PNTR_POW(sp->lpfResonance, 2.0f) * 20.0f) * (0.01f + fltw);
-  if (fltdmp > 0.8f)
-    fltdmp = 0.8f;
-  fltphp = 0.0f;
-  flthp = PNTR_POW(sp->hpfCutoff, 2.0f) * 0.1f;
-  flthpd = 1.0f + sp->hpfCutoffSweep * 0.0003f;
+  state->fltp = state->fltdp = 0.0f;
+  state->fltw = patch->fltw;
+  state->fltphp = 0.0f;
+  state->flthp = patch->flthp;
 
   // Reset vibrato
-  vibratoPhase = 0.0f;
-  vibratoSpeed = PNTR_POW(sp->vibratoSpeed, 2.0f) * 0.01f;
-  vibratoAmplitude = sp->vibratoDepth * 0.5f;
+  state->vibratoPhase = 0.0f;
 
   // Reset envelope
-  envVolume = 0.0f;
-  envStage = envTime = 0;
-  envLength[0] = (int)(sp->attackTime * sp->attackTime * 100000.0f);
-  envLength[1] = (int)(sp->sustainTime * sp->sustainTime * 100000.0f);
-  envLength[2] = (int)(sp->decayTime * sp->decayTime * 100000.0f);
-
-  fphase = PNTR_POW(sp->phaserOffset, 2.0f) * 1020.0f;
-  if (sp->phaserOffset < 0.0f)
-    fphase = -fphase;
+  state->envVolume = 0.0f;
+  state->envStage = state->envTime = 0;
 
-  fdphase = PNTR_POW(sp->phaserSweep, 2.0f) * 1.0f;
-  if (sp->phaserSweep < 0.0f)
-    fdphase = -fdphase;
-
-  iphase = abs((int)fphase);
-  ipp = 0;
-  for (i = 0; i < 1024; i++)
-    phaserBuffer[i] = 0.0f;
+  state->fphase = patch->fphase;
+  state->iphase = abs((int)state->fphase);
+  state->ipp = 0;
 
-  if (sp->waveType == SFX_PINK_NOISE) {
-    pinkI = 0;
-    for (i = 0; i < PINK_SIZE; i++)
-      synth->pinkWhiteValue[i] = frnd(app, 1.0f);
+  // Only kernels with the phaser stage read the delay line.
+  if (patch->kernelFlags & _SFX_KERNEL_PHASER) {
+    for (n = 0; n < _SFX_PHASER_SIZE; n++)
+      state->phaserBuffer[n] = 0.0f;
   }
 
-#define RESET_NOISE                                                   \
-  if (sp->waveType == SFX_NOISE) {                                    \
-    for (i = 0; i < 32; i++)                                          \
-      noiseBuffer[i] = rndNP1(app);                                   \
-  } else if (sp->waveType == SFX_PINK_NOISE) {                        \
-    for (i = 0; i < 32; i++)                                          \
-      noiseBuffer[i] = pinkValue(app, &pinkI, synth->pinkWhiteValue); \
+  pinkI = 0;
+  if (waveType == SFX_PINK_NOISE) {
+    for (n = 0; n < PINK_SIZE; n++)
+      state->pinkWhiteValue[n] = frnd(&rng, 1.0f);
   }
 
   RESET_NOISE
+  state->pinkI = pinkI;
+  state->rng = rng;
 
-  repeatTime = 0;
-  repeatLimit = (int)(PNTR_POW(1.0f - sp->repeatSpeed, 2.0f) * 20000 + 32);
-  if (sp->repeatSpeed == 0.0f)
-    repeatLimit = 0;
+  state->repeatTime = 0;
+
+  state->silenceThreshold = modes->silenceThreshold;
+  state->silenceHold = (int)(modes->silenceHold * patch->sampleRate);
+  state->audible = 0;
+  state->quietTime = 0;
+
+  PNTR_MEMSET(&state->profile, 0, sizeof(SfxProfile));
+
+  // Choose the render kernel for the stages this sound uses.
+  state->kernelFlags = patch->kernelFlags;
+  if (modes->oscillator == SFX_OSCILLATOR_POLYBLEP)
+    state->kernelFlags |= _SFX_KERNEL_POLYBLEP;
+}
+
+/*
+ * Prepare a render state to synthesize a compiled patch, like
+ * pntr_app_sfx_begin_render() does for params. The patch is copied.
+ */
+void pntr_app_sfx_begin_render_patch(SfxSynthState* state, const SfxPatch* patch, int format) {
+  _SfxModes modes;
+
+  _pntr_app_sfx_get_modes(&modes);
+  _pntr_app_sfx_begin_render_modes(state, patch, format, &modes);
+}
+
+// Render loop shared by all kernels. waveType and flags are constants in
+// each kernel, so the compiler drops the stages a kernel does not use.
+_PNTR_APP_SFX_FORCE_INLINE int _pntr_app_sfx_render_kernel(SfxSynthState* state, void* out, int frames, const int waveType, const int flags) {
+  const SfxPatch* patch = &state->patch;
+  uint32_t rng = state->rng;
+  float* phaserBuffer = state->phaserBuffer;
+  float* noiseBuffer = state->noiseBuffer;
+  int phase = state->phase;
+  double fperiod = state->fperiod;
+  const double fmaxperiod = patch->fmaxperiod;
+  double fslide = state->fslide;
+  const double fdslide = patch->fdslide;
+  int period = state->period;
+  float squareDuty = state->squareDuty;
+  const float squareSlide = patch->squareSlide;
+  int envStage = state->envStage;
+  int envTime = state->envTime;
+  float envVolume = state->envVolume;
+  float fphase = state->fphase;
+  const float fdphase = patch->fdphase;
+  int iphase = state->iphase;
+  int ipp = state->ipp;
+  float fltp = state->fltp;
+  float fltdp = state->fltdp;
+  float fltw = state->fltw;
+  const float fltwd = patch->fltwd;
+  const float fltdmp = patch->fltdmp;
+  float fltphp = state->fltphp;
+  float flthp = state->flthp;
+  const float flthpd = patch->flthpd;
+  float vibratoPhase = state->vibratoPhase;
+  const float vibratoSpeed = patch->vibratoSpeed;
+  const float vibratoAmplitude = patch->vibratoAmplitude;
+  int repeatTime = state->repeatTime;
+  const int repeatLimit = patch->repeatLimit;
+  int arpeggioTime = state->arpeggioTime;
+  int arpeggioLimit = state->arpeggioLimit;
+  const double arpeggioModulation = patch->arpeggioModulation;
+  const float minFreq = patch->minFreq;
+  int pinkI = state->pinkI;
+  const int* envLength = patch->envLength;
+  const double rateScale = patch->rateScale;
+  const float silenceThreshold = state->silenceThreshold;
+  const int silenceHold = state->silenceHold;
+  int audible = state->audible;
+  int quietTime = state->quietTime;
+  int sampleCount, n;
+#ifdef PNTR_APP_SFX_PROFILE
+  SfxProfile profile = {0};
+  uint64_t profileStart = _pntr_app_sfx_time_ns();
+  uint64_t profileTick = _pntr_app_sfx_ticks();
+#endif
 
   // Synthesize samples.
   {
     const float sampleCoefficient = 0.2f;  // Scales sample value to [-1..1]
 #if SINGLE_FORMAT == 1
-    uint8_t* buffer = synth->samples.u8;
+    uint8_t* buffer = (uint8_t*)out;
 #elif SINGLE_FORMAT == 2
-    int16_t* buffer = synth->samples.i16;
+    int16_t* buffer = (int16_t*)out;
 #else
-    float* buffer = synth->samples.f;
+    float* buffer = (float*)out;
 #endif
-    float ssample, rfperiod, fp, pp;
-    int sampleEnd = synth->sampleRate * synth->maxDuration;
-    int si;
-
-    for (sampleCount = 0; sampleCount < sampleEnd; sampleCount++) {
+    // Precise sine stays scalar, since it relies on PNTR_SINF.
+    _SfxOscillateFunc oscillate = _pntr_app_sfx_select_oscillator(state->simd);
+    const int fastMath = state->mathMode == SFX_MATH_FAST;
+    const int vectorWave = waveType == SFX_SQUARE || waveType == SFX_SAWTOOTH || waveType == SFX_TRIANGLE || (waveType == SFX_SINE && fastMath);
+    float wave[8];
+    float ssample, rfperiod, pp;
+    int sampleEnd = frames;
+    int si, gi;
+
+    // Filter limits, scaled to the sample rate like the coefficients, and
+    // kept where the filters are stable
+    const float rate = (float)rateScale;
+    const float fltwMax = 0.1f / (rate * rate) < _SFX_LPF_MAX ? 0.1f / (rate * rate) : _SFX_LPF_MAX;
+    const float flthpMin = 0.00001f / rate;
+    const float flthpMax = 0.1f / rate < _SFX_HPF_MAX ? 0.1f / rate : _SFX_HPF_MAX;
+
+    // Below 8x, each filter step stands for 2^filterShift of the 8x steps the
+    // coefficients are tuned for. 16x averages pairs of sub-samples into 8 steps.
+    const int supersample = (flags & _SFX_KERNEL_POLYBLEP) ? 1 : _pntr_app_sfx_supersample(state->supersample);
+    const int filterShift = supersample >= 8 ? 0 : supersample == 4 ? 1 : supersample == 2 ? 2 : 3;
+    const int filterSteps = 8 >> filterShift;
+    const int group = supersample / filterSteps;  // Sub-samples per filter step
+    const int stride = 1 << filterShift;          // Phase advance per filter step
+    float fltwdk = fltwd;                         // Low-pass sweep over a filter step
+    for (si = 0; si < filterShift; si++)
+      fltwdk *= fltwdk;
+
+    // sampleCount only advances for samples that are written out.
+    for (sampleCount = 0; sampleCount < sampleEnd;) {
       repeatTime++;
       if (repeatLimit != 0 && repeatTime >= repeatLimit) {
         repeatTime = 0;
         RESET_SAMPLE
+        _SFX_PROFILE_COUNT(repeatResets, 1);
       }
 
       // Frequency envelopes/arpeggios
@@ -429,20 +2075,23 @@ int pntr_app_sfx_generate_wave(pntr_app* app, SfxSynth* synth, const SfxParams*
 
       if (fperiod > fmaxperiod) {
         fperiod = fmaxperiod;
-        if (minFreq > 0.0f)
+        if (minFreq > 0.0f) {
           sampleEnd = sampleCount;  // End generator loop.
+          state->finished = 1;
+          _SFX_PROFILE_COUNT(cutoffEnds, 1);
+        }
       }
 
       rfperiod = (float)fperiod;
 
       if (vibratoAmplitude > 0.0f) {
         vibratoPhase += vibratoSpeed;
-        rfperiod = (float)(fperiod * (1.0 + PNTR_SINF(vibratoPhase) * vibratoAmplitude));
+        rfperiod = (float)(fperiod * (1.0 + (fastMath ? _pntr_app_sfx_sin(vibratoPhase) : PNTR_SINF(vibratoPhase)) * vibratoAmplitude));
       }
 
       period = (int)rfperiod;
-      if (period < 8)
-        period = 8;
+      if (period < patch->minPeriod)
+        period = patch->minPeriod;
 
       squareDuty += squareSlide;
       if (squareDuty < 0.0f)
@@ -456,8 +2105,11 @@ int pntr_app_sfx_generate_wave(pntr_app* app, SfxSynth* synth, const SfxParams*
         envTime = 0;
       next_stage:
         envStage++;
-        if (envStage == 3)
+        if (envStage == 3) {
+          state->finished = 1;
+          _SFX_PROFILE_COUNT(envelopeEnds, 1);
           break;  // End generator loop.
+        }
         if (envLength[envStage] == 0)
           goto next_stage;
       }
@@ -467,7 +2119,7 @@ int pntr_app_sfx_generate_wave(pntr_app* app, SfxSynth* synth, const SfxParams*
           envVolume = (float)envTime / envLength[0];
           break;
         case 1:
-          envVolume = 1.0f + PNTR_POW(1.0f - (float)envTime / envLength[1], 1.0f) * 2.0f * sp->sustainPunch;
+          envVolume = 1.0f + (1.0f - (float)envTime / envLength[1]) * 2.0f * patch->sustainPunch;
           break;
         case 2:
           envVolume = 1.0f - (float)envTime / envLength[2];
@@ -475,111 +2127,241 @@ int pntr_app_sfx_generate_wave(pntr_app* app, SfxSynth* synth, const SfxParams*
       }
 
       // Phaser step
-      fphase += fdphase;
-      iphase = abs((int)fphase);
+      if (flags & _SFX_KERNEL_PHASER) {
+        fphase += fdphase;
+        iphase = abs((int)fphase);
 
-      if (iphase > 1023)
-        iphase = 1023;
+        if (iphase > patch->phaserLimit)
+          iphase = patch->phaserLimit;
+      }
 
       if (flthpd != 0.0f) {
         flthp *= flthpd;
-        if (flthp < 0.00001f)
-          flthp = 0.00001f;
-        else if (flthp > 0.1f)
-          flthp = 0.1f;
+        if (flthp < flthpMin)
+          flthp = flthpMin;
+        else if (flthp > flthpMax)
+          flthp = flthpMax;
       }
+      _SFX_PROFILE_MARK(SFX_STAGE_ENVELOPE);
 
-      // 8x supersampling
-      ssample = 0.0f;
-      for (si = 0; si < 8; si++) {
-        float sample = 0.0f;
-        phase++;
+      if (flags & _SFX_KERNEL_POLYBLEP) {
+        // One band-limited sub-sample, standing in for 8
+        float sample;
 
+        phase += 8;
         if (phase >= period) {
-          // phase = 0;
           phase %= period;
 
-          RESET_NOISE
+          _SFX_RENDER_RESET_NOISE
         }
 
-        // Base waveform
-        fp = (float)phase / period;
-
-#define RAMP(v, x1, x2, y1, y2) (y1 + (y2 - y1) * ((v - x1) / (x2 - x1)))
-
-        switch (sp->waveType) {
-          case SFX_SQUARE:
-            sample = (fp < squareDuty) ? 0.5f : -0.5f;
-            break;
-          case SFX_SAWTOOTH:
-#ifdef SAWTOOTH_DUTY
-            sample = (fp < squareDuty) ? -1.0f + 2.0f * fp / squareDuty : 1.0f - 2.0f * (fp - squareDuty) / (1.0f - squareDuty);
-#else
-            sample = 1.0f - fp * 2;
-#endif
-            break;
-          case SFX_SINE:
-            sample = PNTR_SINF(fp * 2 * PNTR_PI);
-            break;
-          case SFX_NOISE:
-          case SFX_PINK_NOISE:
-            sample = noiseBuffer[phase * 32 / period];
-            break;
-          case SFX_TRIANGLE:
-            sample = (fp < 0.5) ? RAMP(fp, 0.0f, 0.5f, -1.0f, 1.0f) : RAMP(fp, 0.5f, 1.0f, 1.0f, -1.0f);
-            break;
-        }
+        // Pitched waves are taken mid-sample, where the 8 sub-samples they
+        // stand in for are centered.
+        if (waveType == SFX_NOISE || waveType == SFX_PINK_NOISE)
+          sample = noiseBuffer[phase * 32 / period];
+        else
+          sample = _pntr_app_sfx_blep_wave(waveType, phase >= 4 ? phase - 4 : phase - 4 + period, period, squareDuty, fastMath);
+        _SFX_PROFILE_MARK(SFX_STAGE_OSCILLATOR);
+        _SFX_PROFILE_COUNT(subSamples, 1);
 
-        // Low-pass filter
+        // Low-pass and high-pass filters, 8 steps at once
         pp = fltp;
-        fltw *= fltwd;
-
-        if (fltw < 0.0f)
-          fltw = 0.0f;
-        else if (fltw > 0.1f)
-          fltw = 0.1f;
-
-        if (sp->lpfCutoff != 1.0f) {
-          fltdp += (sample - fltp) * fltw;
-          fltdp -= fltdp * fltdmp;
+        if (flags & _SFX_KERNEL_LPF) {
+          fltw *= fltwdk;
+          if (fltw < 0.0f)
+            fltw = 0.0f;
+          else if (fltw > fltwMax)
+            fltw = fltwMax;
+          _pntr_app_sfx_lpf_steps(&fltp, &fltdp, sample, fltw, fltdmp, filterShift);
         } else {
           fltp = sample;
-          fltdp = 0.0f;
         }
+        fltphp = (fltphp + fltp - pp) * _pntr_app_sfx_hpf_decay(flthp, filterShift);
+        sample = fltphp;
+        _SFX_PROFILE_MARK(SFX_STAGE_FILTER);
 
-        fltp += fltdp;
+        // Phaser, with its delay in samples
+        if (flags & _SFX_KERNEL_PHASER) {
+          phaserBuffer[ipp & _SFX_PHASER_MASK] = sample;
+          sample += phaserBuffer[(ipp - (iphase >> filterShift) + _SFX_PHASER_SIZE) & _SFX_PHASER_MASK];
+          ipp = (ipp + 1) & _SFX_PHASER_MASK;
+        } else {
+          sample += sample;
+        }
 
-        // High-pass filter
-        fltphp += fltp - pp;
-        fltphp -= fltphp * flthp;
-        sample = fltphp;
+        ssample = sample * envVolume * sampleCoefficient;
+        _SFX_PROFILE_MARK(SFX_STAGE_PHASER);
+      } else if (supersample != 8) {
+        // 1x, 2x, 4x or 16x supersampling, with the filters stepped to match 8x
+        ssample = 0.0f;
+        for (si = 0; si < filterSteps; si++) {
+          float sample = 0.0f;
+
+          phase += stride;
+          if (phase >= period) {
+            phase %= period;
+
+            _SFX_RENDER_RESET_NOISE
+          }
+
+          // Sub-samples are taken at the centers of the 8x sub-samples they stand for.
+          for (gi = 0; gi < group; gi++) {
+            float fp = phase - (stride - 1) * 0.5f - (group - 1 - gi) * 0.5f;
+            if (fp < 0.0f)
+              fp += period;
+            fp /= period;
+
+            if (waveType == SFX_NOISE || waveType == SFX_PINK_NOISE)
+              sample += noiseBuffer[phase * 32 / period];
+            else if (waveType == SFX_SINE && fastMath)
+              sample += _pntr_app_sfx_sin_turns(fp);
+            else
+              sample += _pntr_app_sfx_wave(waveType, fp, squareDuty);
+          }
+          if (group > 1)
+            sample *= 0.5f;
+          _SFX_PROFILE_MARK(SFX_STAGE_OSCILLATOR);
+          _SFX_PROFILE_COUNT(subSamples, group);
+
+          pp = fltp;
+          if (flags & _SFX_KERNEL_LPF) {
+            fltw *= fltwdk;
+            if (fltw < 0.0f)
+              fltw = 0.0f;
+            else if (fltw > fltwMax)
+              fltw = fltwMax;
+            _pntr_app_sfx_lpf_steps(&fltp, &fltdp, sample, fltw, fltdmp, filterShift);
+          } else {
+            fltp = sample;
+          }
+          fltphp = (fltphp + fltp - pp) * _pntr_app_sfx_hpf_decay(flthp, filterShift);
+          sample = fltphp;
+          _SFX_PROFILE_MARK(SFX_STAGE_FILTER);
+
+          if (flags & _SFX_KERNEL_PHASER) {
+            phaserBuffer[ipp & _SFX_PHASER_MASK] = sample;
+            sample += phaserBuffer[(ipp - (iphase >> filterShift) + _SFX_PHASER_SIZE) & _SFX_PHASER_MASK];
+            ipp = (ipp + 1) & _SFX_PHASER_MASK;
+          } else {
+            sample += sample;
+          }
+
+          ssample += sample * envVolume;
+          _SFX_PROFILE_MARK(SFX_STAGE_PHASER);
+        }
 
-        // Phaser
-        phaserBuffer[ipp & 1023] = sample;
-        sample += phaserBuffer[(ipp - iphase + 1024) & 1023];
-        ipp = (ipp + 1) & 1023;
+        ssample = ssample / filterSteps * sampleCoefficient;
+      } else {
+        // 8x supersampling
+        if (vectorWave && phase + 8 < period) {
+          // The phase does not wrap, so all 8 sub-samples come from one oscillator call
+          oscillate(waveType, phase, period, squareDuty, wave);
+          phase += 8;
+        } else {
+          for (si = 0; si < 8; si++) {
+            phase++;
+
+            if (phase >= period) {
+              // phase = 0;
+              phase %= period;
+
+              _SFX_RENDER_RESET_NOISE
+            }
+
+            // Base waveform
+            if (waveType == SFX_NOISE || waveType == SFX_PINK_NOISE)
+              wave[si] = noiseBuffer[phase * 32 / period];
+            else if (waveType == SFX_SINE && fastMath)
+              wave[si] = _pntr_app_sfx_sin_turns((float)phase / period);
+            else
+              wave[si] = _pntr_app_sfx_wave(waveType, (float)phase / period, squareDuty);
+          }
+        }
+        _SFX_PROFILE_MARK(SFX_STAGE_OSCILLATOR);
+        _SFX_PROFILE_COUNT(subSamples, 8);
+
+        for (si = 0; si < 8; si++) {
+          float sample = wave[si];
+
+          // Low-pass filter
+          pp = fltp;
+          if (flags & _SFX_KERNEL_LPF) {
+            fltw *= fltwd;
+
+            if (fltw < 0.0f)
+              fltw = 0.0f;
+            else if (fltw > fltwMax)
+              fltw = fltwMax;
+
+            fltdp += (sample - fltp) * fltw;
+            fltdp -= fltdp * fltdmp;
+            fltp += fltdp;
+          } else {
+            // Bypassed: fltdp stays 0
+            fltp = sample;
+          }
+
+          // High-pass filter
+          fltphp += fltp - pp;
+          fltphp -= fltphp * flthp;
+          wave[si] = fltphp;
+        }
+        _SFX_PROFILE_MARK(SFX_STAGE_FILTER);
+
+        ssample = 0.0f;
+        for (si = 0; si < 8; si++) {
+          float sample = wave[si];
+
+          // Phaser
+          if (flags & _SFX_KERNEL_PHASER) {
+            phaserBuffer[ipp & _SFX_PHASER_MASK] = sample;
+            sample += phaserBuffer[(ipp - iphase + _SFX_PHASER_SIZE) & _SFX_PHASER_MASK];
+            ipp = (ipp + 1) & _SFX_PHASER_MASK;
+          } else {
+            // With no offset or sweep the phaser reads back the sample it just wrote
+            sample += sample;
+          }
+
+          // Final accumulation and envelope application
+          ssample += sample * envVolume;
+        }
 
-        // Final accumulation and envelope application
-        ssample += sample * envVolume;
+        ssample = ssample / 8 * sampleCoefficient;
+        _SFX_PROFILE_MARK(SFX_STAGE_PHASER);
       }
 
-      ssample = ssample / 8 * sampleCoefficient;
-
       // Clamp sample and emit to buffer
       if (ssample > 1.0f)
         ssample = 1.0f;
       else if (ssample < -1.0f)
         ssample = -1.0f;
 
+      // Skip leading silence, and end the sound once it has stayed silent
+      // for the hold time after the attack.
+      if (silenceThreshold > 0.0f) {
+        if (ssample >= silenceThreshold || ssample <= -silenceThreshold) {
+          audible = 1;
+          quietTime = 0;
+        } else if (!audible) {
+          _SFX_PROFILE_COUNT(silentSamples, 1);
+          _SFX_PROFILE_MARK(SFX_STAGE_OUTPUT);
+          continue;
+        } else if (envStage > 0 && ++quietTime >= silenceHold) {
+          sampleEnd = sampleCount;  // End generator loop after this sample.
+          state->finished = 1;
+          _SFX_PROFILE_COUNT(silenceEnds, 1);
+        }
+      }
+
         // printf("%d %f\n", sampleCount, ssample);
 #if SINGLE_FORMAT == 1
-      *buffer++ = (uint8_t)(ssample * 127.0f + 128.0f);
+      buffer[sampleCount] = (uint8_t)(ssample * 127.0f + 128.0f);
 #elif SINGLE_FORMAT == 2
-      *buffer++ = (int16_t)(ssample * 32767.0f);
+      buffer[sampleCount] = (int16_t)(ssample * 32767.0f);
 #elif SINGLE_FORMAT == 3
-      *buffer++ = ssample;
+      buffer[sampleCount] = ssample;
 #else
-      switch (synth->sampleFormat) {
+      switch (state->sampleFormat) {
         case SFX_U8:
           ((uint8_t*)buffer)[sampleCount] = (uint8_t)(ssample * 127.0f + 128.0f);
           break;
@@ -591,225 +2373,594 @@ int pntr_app_sfx_generate_wave(pntr_app* app, SfxSynth* synth, const SfxParams*
           break;
       }
 #endif
+      sampleCount++;
+      _SFX_PROFILE_MARK(SFX_STAGE_OUTPUT);
     }
   }
 
+#ifdef PNTR_APP_SFX_PROFILE
+  // The envelope stage ends the sound from inside the loop.
+  _SFX_PROFILE_MARK(SFX_STAGE_ENVELOPE);
+  profile.renders = 1;
+  profile.samples = (uint64_t)sampleCount;
+  profile.renderNs = _pntr_app_sfx_time_ns() - profileStart;
+  _pntr_app_sfx_profile_add(&state->profile, &profile);
+#ifdef PNTR_APP_SFX_THREADS
+  pthread_mutex_lock(&_pntr_app_sfx_profile_lock);
+#endif
+  _pntr_app_sfx_profile_add(&_pntr_app_sfx_profile, &profile);
+#ifdef PNTR_APP_SFX_THREADS
+  pthread_mutex_unlock(&_pntr_app_sfx_profile_lock);
+#endif
+#endif  // PNTR_APP_SFX_PROFILE
+
+  // Store the state for the next block.
+  state->phase = phase;
+  state->fperiod = fperiod;
+  state->fslide = fslide;
+  state->period = period;
+  state->squareDuty = squareDuty;
+  state->envStage = envStage;
+  state->envTime = envTime;
+  state->envVolume = envVolume;
+  state->fphase = fphase;
+  state->iphase = iphase;
+  state->ipp = ipp;
+  state->fltp = fltp;
+  state->fltdp = fltdp;
+  state->fltw = fltw;
+  state->fltphp = fltphp;
+  state->flthp = flthp;
+  state->vibratoPhase = vibratoPhase;
+  state->repeatTime = repeatTime;
+  state->arpeggioTime = arpeggioTime;
+  state->arpeggioLimit = arpeggioLimit;
+  state->pinkI = pinkI;
+  state->rng = rng;
+  state->audible = audible;
+  state->quietTime = quietTime;
+  state->sampleCount += sampleCount;
+
   return sampleCount;
 }
 
-/**
- * Load params from disk
- */
-bool pntr_app_sfx_load_params(SfxParams* params, const char* fileName) {
-  if (fileName == NULL) {
-    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
-    return false;
-  }
-
-  unsigned int bytesRead;
-  unsigned char* fileData = pntr_load_file(fileName, &bytesRead);
-  if (fileData == NULL) {
-    return false;
-  }
-
-  if (fileData[0] != 'r' || fileData[1] != 'F' || fileData[2] != 'X' || fileData[3] != ' ') {
-    pntr_set_error(PNTR_ERROR_FAILED_TO_OPEN);
-    return false;
+#define _PNTR_APP_SFX_KERNEL(name, waveType, flags)                               \
+  static int name(SfxSynthState* state, void* out, int frames) {                  \
+    return _pntr_app_sfx_render_kernel(state, out, frames, (waveType), (flags)); \
   }
 
-  short int version = 0;
-  PNTR_MEMCPY(&version, fileData + 4, 2);
+#define _PNTR_APP_SFX_KERNELS(name, waveType)                                                                      \
+  _PNTR_APP_SFX_KERNEL(name, waveType, 0)                                                                          \
+  _PNTR_APP_SFX_KERNEL(name##_lpf, waveType, _SFX_KERNEL_LPF)                                                      \
+  _PNTR_APP_SFX_KERNEL(name##_phaser, waveType, _SFX_KERNEL_PHASER)                                                \
+  _PNTR_APP_SFX_KERNEL(name##_lpf_phaser, waveType, _SFX_KERNEL_LPF | _SFX_KERNEL_PHASER)                          \
+  _PNTR_APP_SFX_KERNEL(name##_blep, waveType, _SFX_KERNEL_POLYBLEP)                                                \
+  _PNTR_APP_SFX_KERNEL(name##_blep_lpf, waveType, _SFX_KERNEL_POLYBLEP | _SFX_KERNEL_LPF)                          \
+  _PNTR_APP_SFX_KERNEL(name##_blep_phaser, waveType, _SFX_KERNEL_POLYBLEP | _SFX_KERNEL_PHASER)                    \
+  _PNTR_APP_SFX_KERNEL(name##_blep_lpf_phaser, waveType, _SFX_KERNEL_POLYBLEP | _SFX_KERNEL_LPF | _SFX_KERNEL_PHASER)
+
+_PNTR_APP_SFX_KERNELS(_pntr_app_sfx_render_square, SFX_SQUARE)
+_PNTR_APP_SFX_KERNELS(_pntr_app_sfx_render_sawtooth, SFX_SAWTOOTH)
+_PNTR_APP_SFX_KERNELS(_pntr_app_sfx_render_sine, SFX_SINE)
+_PNTR_APP_SFX_KERNELS(_pntr_app_sfx_render_noise, SFX_NOISE)
+_PNTR_APP_SFX_KERNELS(_pntr_app_sfx_render_triangle, SFX_TRIANGLE)
+_PNTR_APP_SFX_KERNELS(_pntr_app_sfx_render_pink_noise, SFX_PINK_NOISE)
+
+typedef int (*_SfxKernelFunc)(SfxSynthState* state, void* out, int frames);
+
+// Indexed by wave type, then by kernel flags.
+static const _SfxKernelFunc _pntr_app_sfx_kernels[6][8] = {
+    {_pntr_app_sfx_render_square,
+     _pntr_app_sfx_render_square_lpf,
+     _pntr_app_sfx_render_square_phaser,
+     _pntr_app_sfx_render_square_lpf_phaser,
+     _pntr_app_sfx_render_square_blep,
+     _pntr_app_sfx_render_square_blep_lpf,
+     _pntr_app_sfx_render_square_blep_phaser,
+     _pntr_app_sfx_render_square_blep_lpf_phaser},
+    {_pntr_app_sfx_render_sawtooth,
+     _pntr_app_sfx_render_sawtooth_lpf,
+     _pntr_app_sfx_render_sawtooth_phaser,
+     _pntr_app_sfx_render_sawtooth_lpf_phaser,
+     _pntr_app_sfx_render_sawtooth_blep,
+     _pntr_app_sfx_render_sawtooth_blep_lpf,
+     _pntr_app_sfx_render_sawtooth_blep_phaser,
+     _pntr_app_sfx_render_sawtooth_blep_lpf_phaser},
+    {_pntr_app_sfx_render_sine,
+     _pntr_app_sfx_render_sine_lpf,
+     _pntr_app_sfx_render_sine_phaser,
+     _pntr_app_sfx_render_sine_lpf_phaser,
+     _pntr_app_sfx_render_sine_blep,
+     _pntr_app_sfx_render_sine_blep_lpf,
+     _pntr_app_sfx_render_sine_blep_phaser,
+     _pntr_app_sfx_render_sine_blep_lpf_phaser},
+    {_pntr_app_sfx_render_noise,
+     _pntr_app_sfx_render_noise_lpf,
+     _pntr_app_sfx_render_noise_phaser,
+     _pntr_app_sfx_render_noise_lpf_phaser,
+     _pntr_app_sfx_render_noise_blep,
+     _pntr_app_sfx_render_noise_blep_lpf,
+     _pntr_app_sfx_render_noise_blep_phaser,
+     _pntr_app_sfx_render_noise_blep_lpf_phaser},
+    {_pntr_app_sfx_render_triangle,
+     _pntr_app_sfx_render_triangle_lpf,
+     _pntr_app_sfx_render_triangle_phaser,
+     _pntr_app_sfx_render_triangle_lpf_phaser,
+     _pntr_app_sfx_render_triangle_blep,
+     _pntr_app_sfx_render_triangle_blep_lpf,
+     _pntr_app_sfx_render_triangle_blep_phaser,
+     _pntr_app_sfx_render_triangle_blep_lpf_phaser},
+    {_pntr_app_sfx_render_pink_noise,
+     _pntr_app_sfx_render_pink_noise_lpf,
+     _pntr_app_sfx_render_pink_noise_phaser,
+     _pntr_app_sfx_render_pink_noise_lpf_phaser,
+     _pntr_app_sfx_render_pink_noise_blep,
+     _pntr_app_sfx_render_pink_noise_blep_lpf,
+     _pntr_app_sfx_render_pink_noise_blep_phaser,
+     _pntr_app_sfx_render_pink_noise_blep_lpf_phaser}};
 
-  // only 200 is supported
-  if (version != 200) {
-    pntr_set_error(PNTR_ERROR_FAILED_TO_OPEN);
-    return false;
-  }
+/*
+ * Synthesize up to frames samples into out, continuing where the last call
+ * stopped. out must hold frames samples of the format given to
+ * pntr_app_sfx_begin_render().
+ *
+ * Return the number of samples written. Fewer than frames means the sound
+ * has ended, and every following call returns 0.
+ */
+int pntr_app_sfx_render(SfxSynthState* state, void* out, int frames) {
+  int waveType = state->patch.waveType;
 
-  short int len = 0;
-  PNTR_MEMCPY(&len, fileData + 6, 2);
+  if (state->finished)
+    return 0;
 
-  // only 96 is supported
-  if (len != 96) {
-    pntr_set_error(PNTR_ERROR_FAILED_TO_OPEN);
-    return false;
-  }
+  // Unknown wave types render silence through the generic loop, like before.
+  if (waveType < SFX_SQUARE || waveType > SFX_PINK_NOISE)
+    return _pntr_app_sfx_render_kernel(state, out, frames, waveType, state->kernelFlags);
 
-  PNTR_MEMCPY(params, fileData + 8, 96);
-  return true;
+  return _pntr_app_sfx_kernels[waveType][state->kernelFlags](state, out, frames);
 }
 
-/**
- * Save params to disk
+/*
+ * Count the samples params will generate, without synthesizing them.
+ * This follows the envelope and the minFrequency cutoff of the render loop,
+ * so the result is exact.
  */
-bool pntr_app_sfx_save_params(SfxParams* params, const char* fileName) {
-  if (fileName == NULL) {
-    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
-    return false;
-  }
-
-  unsigned char fileData[104] = {0};
+int pntr_app_sfx_sample_count(const SfxParams* params) {
+  return pntr_app_sfx_sample_count_ex(params, 44100);
+}
 
-  char* signature = "rFX ";
-  short int version = 200;
-  short int len = 96;
-  PNTR_MEMCPY(&fileData, signature, 4);
-  PNTR_MEMCPY(fileData + 4, &version, sizeof(short int));
-  PNTR_MEMCPY(fileData + 4 + sizeof(short int), &len, sizeof(short int));
-  PNTR_MEMCPY(fileData + 4 + sizeof(short int) + sizeof(short int), &params, sizeof(SfxParams));
+/*
+ * Like pntr_app_sfx_sample_count(), for a sound rendered at sampleRate.
+ */
+int pntr_app_sfx_sample_count_ex(const SfxParams* params, int sampleRate) {
+  SfxPatch patch;
 
-  return pntr_save_file(fileName, &fileData, 4 + sizeof(short int) * + sizeof(short int) + sizeof(SfxParams));
+  pntr_app_sfx_compile_ex(params, &patch, sampleRate);
+  return pntr_app_sfx_patch_sample_count(&patch);
 }
 
-void pntr_app_sfx_gen_pickup_coin(pntr_app* app, SfxParams* sp) {
+/*
+ * Count the samples a compiled patch will generate, without synthesizing them.
+ */
+int pntr_app_sfx_patch_sample_count(const SfxPatch* patch) {
+  const int* envLength = patch->envLength;
+  double fperiod, fslide;
+  float squareDuty;
+  int period, arpeggioTime, arpeggioLimit, repeatTime;
+  int sampleCount, envSamples;
+
+  // Stage 0 starts at envTime 1, the following stages at 0, and empty stages are skipped.
+  envSamples = envLength[0];
+  if (envLength[1] > 0)
+    envSamples += envLength[1] + 1;
+  if (envLength[2] > 0)
+    envSamples += envLength[2] + 1;
+
+  if (patch->sampleRate > PNTR_APP_SFX_MAX_SAMPLE_RATE)
+    return 0;
+  if (patch->minFreq <= 0.0f)
+    return envSamples;
+
+  RESET_SAMPLE
+  (void)period;
+  (void)squareDuty;
+  repeatTime = 0;
+
+  // Run only the period slide of the render loop, to find where the cutoff ends the sound.
+  for (sampleCount = 0; sampleCount < envSamples; sampleCount++) {
+    repeatTime++;
+    if (patch->repeatLimit != 0 && repeatTime >= patch->repeatLimit) {
+      repeatTime = 0;
+      RESET_SAMPLE
+    }
+
+    arpeggioTime++;
+    if ((arpeggioLimit != 0) && (arpeggioTime >= arpeggioLimit)) {
+      arpeggioLimit = 0;
+      fperiod *= patch->arpeggioModulation;
+    }
+
+    fslide += patch->fdslide;
+    fperiod *= fslide;
+
+    if (fperiod > patch->fmaxperiod)
+      return sampleCount + 1;
+  }
+  return envSamples;
+}
+
+/*
+ * Synthesize wave data from parameters.
+ * A mono channel wave is generated at synth->sampleRate, and synth->supersample
+ * sub-samples per sample. Time constants and filter coefficients are scaled
+ * to both, so sounds keep their timing and character.
+ * app is unused, as noise is seeded from sp->randSeed.
+ *
+ * Return the number of samples generated.
+ */
+int pntr_app_sfx_generate_wave(pntr_app* app, SfxSynth* synth, const SfxParams* sp) {
+  int maxSamples = synth->maxSamples ? synth->maxSamples : synth->sampleRate * synth->maxDuration;
+  int bytesPerSample = synth->sampleFormat == SFX_F32 ? 4 : synth->sampleFormat == SFX_I16 ? 2 : 1;
+  SfxTraceEvent event;
+  uint64_t start;
+  int sampleCount;
+
+  (void)app;
+  start = _pntr_app_sfx_trace_start(&event, SFX_TRACE_GENERATE_WAVE, sp, synth->sampleFormat, synth->sampleRate);
+  pntr_app_sfx_begin_render_ex(&synth->state, sp, synth->sampleFormat, synth->sampleRate);
+  synth->state.supersample = synth->supersample;
+  sampleCount = pntr_app_sfx_render(&synth->state, synth->samples.f, maxSamples);
+  _pntr_app_sfx_trace_finish(&event, start, sampleCount, (size_t)sampleCount * bytesPerSample);
+  return sampleCount;
+}
+
+// rFX files are a 4 byte signature, a 2 byte version, a 2 byte length, and the params.
+#define _SFX_RFX_SIZE 104
+
+/*
+ * Load params from rFX file data in memory.
+ */
+bool pntr_app_sfx_load_params_from_memory(SfxParams* params, const void* data, size_t size) {
+  const unsigned char* bytes = (const unsigned char*)data;
+
+  if (params == NULL || data == NULL) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return false;
+  }
+
+  if (size < _SFX_RFX_SIZE || bytes[0] != 'r' || bytes[1] != 'F' || bytes[2] != 'X' || bytes[3] != ' ') {
+    pntr_set_error(PNTR_ERROR_FAILED_TO_OPEN);
+    return false;
+  }
+
+  // only version 200 with 96 bytes of params is supported
+  if ((bytes[4] | (bytes[5] << 8)) != 200 || (bytes[6] | (bytes[7] << 8)) != 96) {
+    pntr_set_error(PNTR_ERROR_FAILED_TO_OPEN);
+    return false;
+  }
+
+  PNTR_MEMCPY(params, bytes + 8, 96);
+  return true;
+}
+
+/*
+ * Load params from disk
+ */
+bool pntr_app_sfx_load_params(SfxParams* params, const char* fileName) {
+  if (params == NULL || fileName == NULL) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return false;
+  }
+
+  unsigned int bytesRead;
+  unsigned char* fileData = pntr_load_file(fileName, &bytesRead);
+  if (fileData == NULL) {
+    return false;
+  }
+
+  bool result = pntr_app_sfx_load_params_from_memory(params, fileData, bytesRead);
+  pntr_unload_file(fileData);
+  return result;
+}
+
+/*
+ * Save params to disk
+ */
+bool pntr_app_sfx_save_params(SfxParams* params, const char* fileName) {
+  if (params == NULL || fileName == NULL) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return false;
+  }
+
+  unsigned char fileData[_SFX_RFX_SIZE] = {'r', 'F', 'X', ' ', 200, 0, 96, 0};
+  PNTR_MEMCPY(fileData + 8, params, 96);
+
+  return pntr_save_file(fileName, fileData, _SFX_RFX_SIZE);
+}
+
+/*
+ * Load many rFX files into params[0..count-1], each through
+ * pntr_app_sfx_load_params(). Params of files that fail to load are reset.
+ *
+ * Return the number of files loaded.
+ */
+int pntr_app_sfx_load_params_files(SfxParams* params, const char* const* fileNames, int count) {
+  int loaded = 0;
+
+  if (params == NULL || fileNames == NULL || count < 0) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return 0;
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (fileNames[i] != NULL && pntr_app_sfx_load_params(&params[i], fileNames[i])) {
+      loaded++;
+    } else {
+      pntr_app_sfx_reset_params(&params[i]);
+    }
+  }
+  return loaded;
+}
+
+// Whether a file name ends with .rfx, in any case.
+static bool _pntr_app_sfx_is_rfx(const char* name) {
+  size_t length = 0;
+  while (name[length] != '\0') {
+    length++;
+  }
+  return length > 4 && name[length - 4] == '.' &&
+         (name[length - 3] | 0x20) == 'r' && (name[length - 2] | 0x20) == 'f' && (name[length - 1] | 0x20) == 'x';
+}
+
+// Load one directory entry of pntr_app_sfx_load_params_dir(), path holding the directory.
+static bool _pntr_app_sfx_load_dir_entry(char* path, size_t dirLength, const char* name, SfxLoadCallback callback, void* userData) {
+  SfxParams params;
+  size_t nameLength = 0;
+
+  if (!_pntr_app_sfx_is_rfx(name)) {
+    return false;
+  }
+  while (name[nameLength] != '\0') {
+    nameLength++;
+  }
+  if (dirLength + nameLength + 1 > PNTR_APP_SFX_MAX_PATH) {
+    return false;
+  }
+
+  PNTR_MEMCPY(path + dirLength, name, nameLength + 1);
+  if (!pntr_app_sfx_load_params(&params, path)) {
+    return false;
+  }
+  callback(path, &params, userData);
+  return true;
+}
+
+/*
+ * Load every .rfx file in a directory, calling callback with each one's path
+ * and params. Paths are built in one fixed buffer and each file is read with
+ * pntr_app_sfx_load_params().
+ *
+ * Return the number of files loaded.
+ */
+int pntr_app_sfx_load_params_dir(const char* dirPath, SfxLoadCallback callback, void* userData) {
+  char path[PNTR_APP_SFX_MAX_PATH];
+  size_t dirLength = 0;
+  int loaded = 0;
+
+  if (dirPath == NULL || callback == NULL) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return 0;
+  }
+
+  while (dirPath[dirLength] != '\0') {
+    dirLength++;
+  }
+  if (dirLength + 7 > sizeof(path)) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return 0;
+  }
+  PNTR_MEMCPY(path, dirPath, dirLength);
+  if (dirLength > 0 && path[dirLength - 1] != '/' && path[dirLength - 1] != '\\') {
+    path[dirLength++] = '/';
+  }
+
+#if defined(_WIN32)
+  WIN32_FIND_DATAA found;
+  HANDLE search;
+
+  PNTR_MEMCPY(path + dirLength, "*.rfx", 6);
+  search = FindFirstFileA(path, &found);
+  if (search == INVALID_HANDLE_VALUE) {
+    pntr_set_error(PNTR_ERROR_FAILED_TO_OPEN);
+    return 0;
+  }
+  do {
+    loaded += _pntr_app_sfx_load_dir_entry(path, dirLength, found.cFileName, callback, userData);
+  } while (FindNextFileA(search, &found));
+  FindClose(search);
+#elif defined(PNTR_APP_SFX_DIRENT)
+  DIR* dir = opendir(dirPath);
+  struct dirent* found;
+
+  if (dir == NULL) {
+    pntr_set_error(PNTR_ERROR_FAILED_TO_OPEN);
+    return 0;
+  }
+  while ((found = readdir(dir)) != NULL) {
+    loaded += _pntr_app_sfx_load_dir_entry(path, dirLength, found->d_name, callback, userData);
+  }
+  closedir(dir);
+#else
+  (void)buffer;
+  (void)userData;
+  pntr_set_error(PNTR_ERROR_NOT_SUPPORTED);
+#endif
+
+  return loaded;
+}
+
+// Reset sp for a preset and seed its generator. The seed comes from app, or
+// from sp->randSeed when app is NULL. Then sp->randSeed is advanced to the
+// next state of the generator, so the same seed gives the same sound and
+// repeated calls give new ones.
+static uint32_t _pntr_app_sfx_preset_seed(pntr_app* app, SfxParams* sp) {
+  uint32_t seed = (app != NULL) ? (uint32_t)pntr_app_random(app, 0, 0xFFFFFF) : sp->randSeed;
+  uint32_t rng = _pntr_app_sfx_seed_rand(seed);
+
   pntr_app_sfx_reset_params(sp);
+  sp->randSeed = (app != NULL) ? seed : _pntr_app_sfx_rand(&rng);
+  return rng;
+}
+
+void pntr_app_sfx_gen_pickup_coin(pntr_app* app, SfxParams* sp) {
+  uint32_t rng = _pntr_app_sfx_preset_seed(app, sp);
 
-  sp->startFrequency = 0.4f + frnd(app, 0.5f);
+  sp->startFrequency = 0.4f + frnd(&rng, 0.5f);
   sp->attackTime = 0.0f;
-  sp->sustainTime = frnd(app, 0.1f);
-  sp->decayTime = 0.1f + frnd(app, 0.4f);
-  sp->sustainPunch = 0.3f + frnd(app, 0.3f);
+  sp->sustainTime = frnd(&rng, 0.1f);
+  sp->decayTime = 0.1f + frnd(&rng, 0.4f);
+  sp->sustainPunch = 0.3f + frnd(&rng, 0.3f);
 
-  if (sfx_random(app, 2)) {
-    sp->changeSpeed = 0.5f + frnd(app, 0.2f);
-    sp->changeAmount = 0.2f + frnd(app, 0.4f);
+  if (sfx_random(&rng, 2)) {
+    sp->changeSpeed = 0.5f + frnd(&rng, 0.2f);
+    sp->changeAmount = 0.2f + frnd(&rng, 0.4f);
   }
 }
 
 void pntr_app_sfx_gen_laser_shoot(pntr_app* app, SfxParams* sp) {
-  pntr_app_sfx_reset_params(sp);
+  uint32_t rng = _pntr_app_sfx_preset_seed(app, sp);
 
-  sp->waveType = sfx_random(app, 3);
+  sp->waveType = sfx_random(&rng, 3);
 
-  if ((sp->waveType == SFX_SINE) && sfx_random(app, 2)) {
-    sp->waveType = sfx_random(app, 2);
+  if ((sp->waveType == SFX_SINE) && sfx_random(&rng, 2)) {
+    sp->waveType = sfx_random(&rng, 2);
   }
 
-  sp->startFrequency = 0.5f + frnd(app, 0.5f);
-  sp->minFrequency = sp->startFrequency - 0.2f - frnd(app, 0.6f);
+  sp->startFrequency = 0.5f + frnd(&rng, 0.5f);
+  sp->minFrequency = sp->startFrequency - 0.2f - frnd(&rng, 0.6f);
 
   if (sp->minFrequency < 0.2f) {
     sp->minFrequency = 0.2f;
   }
 
-  sp->slide = -0.15f - frnd(app, 0.2f);
+  sp->slide = -0.15f - frnd(&rng, 0.2f);
 
-  if (sfx_random(app, 3) == 0) {
-    sp->startFrequency = 0.3f + frnd(app, 0.6f);
-    sp->minFrequency = frnd(app, 0.1f);
-    sp->slide = -0.35f - frnd(app, 0.3f);
+  if (sfx_random(&rng, 3) == 0) {
+    sp->startFrequency = 0.3f + frnd(&rng, 0.6f);
+    sp->minFrequency = frnd(&rng, 0.1f);
+    sp->slide = -0.35f - frnd(&rng, 0.3f);
   }
 
-  if (sfx_random(app, 2)) {
-    sp->squareDuty = frnd(app, 0.5f);
-    sp->dutySweep = frnd(app, 0.2f);
+  if (sfx_random(&rng, 2)) {
+    sp->squareDuty = frnd(&rng, 0.5f);
+    sp->dutySweep = frnd(&rng, 0.2f);
   } else {
-    sp->squareDuty = 0.4f + frnd(app, 0.5f);
-    sp->dutySweep = -frnd(app, 0.7f);
+    sp->squareDuty = 0.4f + frnd(&rng, 0.5f);
+    sp->dutySweep = -frnd(&rng, 0.7f);
   }
 
   sp->attackTime = 0.0f;
-  sp->sustainTime = 0.1f + frnd(app, 0.2f);
-  sp->decayTime = frnd(app, 0.4f);
+  sp->sustainTime = 0.1f + frnd(&rng, 0.2f);
+  sp->decayTime = frnd(&rng, 0.4f);
 
-  if (sfx_random(app, 2)) {
-    sp->sustainPunch = frnd(app, 0.3f);
+  if (sfx_random(&rng, 2)) {
+    sp->sustainPunch = frnd(&rng, 0.3f);
   }
 
-  if (sfx_random(app, 3) == 0) {
-    sp->phaserOffset = frnd(app, 0.2f);
-    sp->phaserSweep = -frnd(app, 0.2f);
+  if (sfx_random(&rng, 3) == 0) {
+    sp->phaserOffset = frnd(&rng, 0.2f);
+    sp->phaserSweep = -frnd(&rng, 0.2f);
   }
 
-  if (sfx_random(app, 2)) {
-    sp->hpfCutoff = frnd(app, 0.3f);
+  if (sfx_random(&rng, 2)) {
+    sp->hpfCutoff = frnd(&rng, 0.3f);
   }
 }
 
 void pntr_app_sfx_gen_explosion(pntr_app* app, SfxParams* sp) {
-  pntr_app_sfx_reset_params(sp);
+  uint32_t rng = _pntr_app_sfx_preset_seed(app, sp);
 
   sp->waveType = SFX_NOISE;
 
-  if (sfx_random(app, 2)) {
-    sp->startFrequency = 0.1f + frnd(app, 0.4f);
-    sp->slide = -0.1f + frnd(app, 0.4f);
+  if (sfx_random(&rng, 2)) {
+    sp->startFrequency = 0.1f + frnd(&rng, 0.4f);
+    sp->slide = -0.1f + frnd(&rng, 0.4f);
   } else {
-    sp->startFrequency = 0.2f + frnd(app, 0.7f);
-    sp->slide = -0.2f - frnd(app, 0.2f);
+    sp->startFrequency = 0.2f + frnd(&rng, 0.7f);
+    sp->slide = -0.2f - frnd(&rng, 0.2f);
   }
 
   sp->startFrequency *= sp->startFrequency;
 
-  if (sfx_random(app, 5) == 0) {
+  if (sfx_random(&rng, 5) == 0) {
     sp->slide = 0.0f;
   }
 
-  if (sfx_random(app, 3) == 0) {
-    sp->repeatSpeed = 0.3f + frnd(app, 0.5f);
+  if (sfx_random(&rng, 3) == 0) {
+    sp->repeatSpeed = 0.3f + frnd(&rng, 0.5f);
   }
 
   sp->attackTime = 0.0f;
-  sp->sustainTime = 0.1f + frnd(app, 0.3f);
-  sp->decayTime = frnd(app, 0.5f);
+  sp->sustainTime = 0.1f + frnd(&rng, 0.3f);
+  sp->decayTime = frnd(&rng, 0.5f);
 
-  if (sfx_random(app, 2) == 0) {
-    sp->phaserOffset = -0.3f + frnd(app, 0.9f);
-    sp->phaserSweep = -frnd(app, 0.3f);
+  if (sfx_random(&rng, 2) == 0) {
+    sp->phaserOffset = -0.3f + frnd(&rng, 0.9f);
+    sp->phaserSweep = -frnd(&rng, 0.3f);
   }
 
-  sp->sustainPunch = 0.2f + frnd(app, 0.6f);
+  sp->sustainPunch = 0.2f + frnd(&rng, 0.6f);
 
-  if (sfx_random(app, 2)) {
-    sp->vibratoDepth = frnd(app, 0.7f);
-    sp->vibratoSpeed = frnd(app, 0.6f);
+  if (sfx_random(&rng, 2)) {
+    sp->vibratoDepth = frnd(&rng, 0.7f);
+    sp->vibratoSpeed = frnd(&rng, 0.6f);
   }
 
-  if (sfx_random(app, 3) == 0) {
-    sp->changeSpeed = 0.6f + frnd(app, 0.3f);
-    sp->changeAmount = 0.8f - frnd(app, 1.6f);
+  if (sfx_random(&rng, 3) == 0) {
+    sp->changeSpeed = 0.6f + frnd(&rng, 0.3f);
+    sp->changeAmount = 0.8f - frnd(&rng, 1.6f);
   }
 }
 
 void pntr_app_sfx_gen_powerup(pntr_app* app, SfxParams* sp) {
-  pntr_app_sfx_reset_params(sp);
+  uint32_t rng = _pntr_app_sfx_preset_seed(app, sp);
 
-  if (sfx_random(app, 2)) {
+  if (sfx_random(&rng, 2)) {
     sp->waveType = SFX_SAWTOOTH;
 #ifdef SAWTOOTH_DUTY
     sp->squareDuty = 1.0f;
 #endif
   } else {
-    sp->squareDuty = frnd(app, 0.6f);
+    sp->squareDuty = frnd(&rng, 0.6f);
   }
 
-  if (sfx_random(app, 2)) {
-    sp->startFrequency = 0.2f + frnd(app, 0.3f);
-    sp->slide = 0.1f + frnd(app, 0.4f);
-    sp->repeatSpeed = 0.4f + frnd(app, 0.4f);
+  if (sfx_random(&rng, 2)) {
+    sp->startFrequency = 0.2f + frnd(&rng, 0.3f);
+    sp->slide = 0.1f + frnd(&rng, 0.4f);
+    sp->repeatSpeed = 0.4f + frnd(&rng, 0.4f);
   } else {
-    sp->startFrequency = 0.2f + frnd(app, 0.3f);
-    sp->slide = 0.05f + frnd(app, 0.2f);
+    sp->startFrequency = 0.2f + frnd(&rng, 0.3f);
+    sp->slide = 0.05f + frnd(&rng, 0.2f);
 
-    if (sfx_random(app, 2)) {
-      sp->vibratoDepth = frnd(app, 0.7f);
-      sp->vibratoSpeed = frnd(app, 0.6f);
+    if (sfx_random(&rng, 2)) {
+      sp->vibratoDepth = frnd(&rng, 0.7f);
+      sp->vibratoSpeed = frnd(&rng, 0.6f);
     }
   }
 
   sp->attackTime = 0.0f;
-  sp->sustainTime = frnd(app, 0.4f);
-  sp->decayTime = 0.1f + frnd(app, 0.4f);
+  sp->sustainTime = frnd(&rng, 0.4f);
+  sp->decayTime = 0.1f + frnd(&rng, 0.4f);
 }
 
 void pntr_app_sfx_gen_hit_hurt(pntr_app* app, SfxParams* sp) {
-  pntr_app_sfx_reset_params(sp);
+  uint32_t rng = _pntr_app_sfx_preset_seed(app, sp);
 
-  sp->waveType = sfx_random(app, 3);
+  sp->waveType = sfx_random(&rng, 3);
   if (sp->waveType == SFX_SINE) {
     sp->waveType = SFX_NOISE;
   } else if (sp->waveType == SFX_SQUARE) {
-    sp->squareDuty = frnd(app, 0.6f);
+    sp->squareDuty = frnd(&rng, 0.6f);
   }
 #ifdef SAWTOOTH_DUTY
   else if (sp->waveType == SFX_SAWTOOTH) {
@@ -817,53 +2968,53 @@ void pntr_app_sfx_gen_hit_hurt(pntr_app* app, SfxParams* sp) {
   }
 #endif
 
-  sp->startFrequency = 0.2f + frnd(app, 0.6f);
-  sp->slide = -0.3f - frnd(app, 0.4f);
+  sp->startFrequency = 0.2f + frnd(&rng, 0.6f);
+  sp->slide = -0.3f - frnd(&rng, 0.4f);
   sp->attackTime = 0.0f;
-  sp->sustainTime = frnd(app, 0.1f);
-  sp->decayTime = 0.1f + frnd(app, 0.2f);
+  sp->sustainTime = frnd(&rng, 0.1f);
+  sp->decayTime = 0.1f + frnd(&rng, 0.2f);
 
-  if (sfx_random(app, 2)) {
-    sp->hpfCutoff = frnd(app, 0.3f);
+  if (sfx_random(&rng, 2)) {
+    sp->hpfCutoff = frnd(&rng, 0.3f);
   }
 }
 
 void pntr_app_sfx_gen_jump(pntr_app* app, SfxParams* sp) {
-  pntr_app_sfx_reset_params(sp);
+  uint32_t rng = _pntr_app_sfx_preset_seed(app, sp);
 
   sp->waveType = SFX_SQUARE;
-  sp->squareDuty = frnd(app, 0.6f);
-  sp->startFrequency = 0.3f + frnd(app, 0.3f);
-  sp->slide = 0.1f + frnd(app, 0.2f);
+  sp->squareDuty = frnd(&rng, 0.6f);
+  sp->startFrequency = 0.3f + frnd(&rng, 0.3f);
+  sp->slide = 0.1f + frnd(&rng, 0.2f);
   sp->attackTime = 0.0f;
-  sp->sustainTime = 0.1f + frnd(app, 0.3f);
-  sp->decayTime = 0.1f + frnd(app, 0.2f);
+  sp->sustainTime = 0.1f + frnd(&rng, 0.3f);
+  sp->decayTime = 0.1f + frnd(&rng, 0.2f);
 
-  if (sfx_random(app, 2)) {
-    sp->hpfCutoff = frnd(app, 0.3f);
+  if (sfx_random(&rng, 2)) {
+    sp->hpfCutoff = frnd(&rng, 0.3f);
   }
 
-  if (sfx_random(app, 2)) {
-    sp->lpfCutoff = 1.0f - frnd(app, 0.6f);
+  if (sfx_random(&rng, 2)) {
+    sp->lpfCutoff = 1.0f - frnd(&rng, 0.6f);
   }
 }
 
 void pntr_app_sfx_gen_blip_select(pntr_app* app, SfxParams* sp) {
-  pntr_app_sfx_reset_params(sp);
+  uint32_t rng = _pntr_app_sfx_preset_seed(app, sp);
 
-  sp->waveType = sfx_random(app, 2);
+  sp->waveType = sfx_random(&rng, 2);
   if (sp->waveType == SFX_SQUARE) {
-    sp->squareDuty = frnd(app, 0.6f);
+    sp->squareDuty = frnd(&rng, 0.6f);
   }
 #ifdef SAWTOOTH_DUTY
   else {
     sp->squareDuty = 1.0f;
   }
 #endif
-  sp->startFrequency = 0.2f + frnd(app, 0.4f);
+  sp->startFrequency = 0.2f + frnd(&rng, 0.4f);
   sp->attackTime = 0.0f;
-  sp->sustainTime = 0.1f + frnd(app, 0.1f);
-  sp->decayTime = frnd(app, 0.2f);
+  sp->sustainTime = 0.1f + frnd(&rng, 0.1f);
+  sp->decayTime = frnd(&rng, 0.2f);
   sp->hpfCutoff = 0.1f;
 }
 
@@ -873,38 +3024,38 @@ void pntr_app_sfx_gen_synth(pntr_app* app, SfxParams* sp) {
   static const float arpeggioMod[7] = {
       0, 0, 0, 0, -0.3162, 0.7454, 0.7454};
 
-  pntr_app_sfx_reset_params(sp);
-
-  sp->waveType = sfx_random(app, 2);
-  sp->startFrequency = synthFreq[sfx_random(app, 3)];
-  sp->attackTime = sfx_random(app, 5) > 3 ? frnd(app, 0.5) : 0;
-  sp->sustainTime = frnd(app, 1.0f);
-  sp->sustainPunch = frnd(app, 1.0f);
-  sp->decayTime = frnd(app, 0.9f) + 0.1f;
-  sp->changeAmount = arpeggioMod[sfx_random(app, 7)];
-  sp->changeSpeed = frnd(app, 0.5f) + 0.4f;
-  sp->squareDuty = frnd(app, 1.0f);
-  sp->dutySweep = (sfx_random(app, 3) == 2) ? frnd(app, 1.0f) : 0.0f;
-  sp->lpfCutoff = (sfx_random(app, 2) == 1) ? 1.0f : 0.9f * frnd(app, 1.0f) * frnd(app, 1.0f) + 0.1f;
-  sp->lpfCutoffSweep = rndNP1(app);
-  sp->lpfResonance = frnd(app, 1.0f);
-  sp->hpfCutoff = (sfx_random(app, 4) == 3) ? frnd(app, 1.0f) : 0.0f;
-  sp->hpfCutoffSweep = (sfx_random(app, 4) == 3) ? frnd(app, 1.0f) : 0.0f;
+  uint32_t rng = _pntr_app_sfx_preset_seed(app, sp);
+
+  sp->waveType = sfx_random(&rng, 2);
+  sp->startFrequency = synthFreq[sfx_random(&rng, 2)];
+  sp->attackTime = sfx_random(&rng, 5) > 3 ? frnd(&rng, 0.5) : 0;
+  sp->sustainTime = frnd(&rng, 1.0f);
+  sp->sustainPunch = frnd(&rng, 1.0f);
+  sp->decayTime = frnd(&rng, 0.9f) + 0.1f;
+  sp->changeAmount = arpeggioMod[sfx_random(&rng, 6)];
+  sp->changeSpeed = frnd(&rng, 0.5f) + 0.4f;
+  sp->squareDuty = frnd(&rng, 1.0f);
+  sp->dutySweep = (sfx_random(&rng, 3) == 2) ? frnd(&rng, 1.0f) : 0.0f;
+  sp->lpfCutoff = (sfx_random(&rng, 2) == 1) ? 1.0f : 0.9f * frnd(&rng, 1.0f) * frnd(&rng, 1.0f) + 0.1f;
+  sp->lpfCutoffSweep = rndNP1(&rng);
+  sp->lpfResonance = frnd(&rng, 1.0f);
+  sp->hpfCutoff = (sfx_random(&rng, 4) == 3) ? frnd(&rng, 1.0f) : 0.0f;
+  sp->hpfCutoffSweep = (sfx_random(&rng, 4) == 3) ? frnd(&rng, 1.0f) : 0.0f;
 }
 
 void pntr_app_sfx_gen_randomize(pntr_app* app, SfxParams* sp, int waveType) {
-  pntr_app_sfx_reset_params(sp);
+  uint32_t rng = _pntr_app_sfx_preset_seed(app, sp);
 
   sp->waveType = waveType;
 
-  sp->startFrequency = PNTR_POW(rndNP1(app), 2.0f);
+  sp->startFrequency = _pntr_app_sfx_square(rndNP1(&rng));
 
-  if (sfx_random(app, 1)) {
-    sp->startFrequency = PNTR_POW(rndNP1(app), 3.0f) + 0.5f;
+  if (sfx_random(&rng, 1)) {
+    sp->startFrequency = _pntr_app_sfx_cube(rndNP1(&rng)) + 0.5f;
   }
 
   sp->minFrequency = 0.0f;
-  sp->slide = PNTR_POW(rndNP1(app), 5.0f);
+  sp->slide = _pntr_app_sfx_pow5(rndNP1(&rng));
 
   if ((sp->startFrequency > 0.7f) && (sp->slide > 0.2f)) {
     sp->slide = -sp->slide;
@@ -913,37 +3064,37 @@ void pntr_app_sfx_gen_randomize(pntr_app* app, SfxParams* sp, int waveType) {
     sp->slide = -sp->slide;
   }
 
-  sp->deltaSlide = PNTR_POW(rndNP1(app), 3.0f);
-  sp->squareDuty = rndNP1(app);
-  sp->dutySweep = PNTR_POW(rndNP1(app), 3.0f);
-  sp->vibratoDepth = PNTR_POW(rndNP1(app), 3.0f);
-  sp->vibratoSpeed = rndNP1(app);
-  // sp->vibratoPhaseDelay = rndNP1(app);
-  sp->attackTime = PNTR_POW(rndNP1(app), 3.0f);
-  sp->sustainTime = PNTR_POW(rndNP1(app), 2.0f);
-  sp->decayTime = rndNP1(app);
-  sp->sustainPunch = PNTR_POW(frnd(app, 0.8f), 2.0f);
+  sp->deltaSlide = _pntr_app_sfx_cube(rndNP1(&rng));
+  sp->squareDuty = rndNP1(&rng);
+  sp->dutySweep = _pntr_app_sfx_cube(rndNP1(&rng));
+  sp->vibratoDepth = _pntr_app_sfx_cube(rndNP1(&rng));
+  sp->vibratoSpeed = rndNP1(&rng);
+  // sp->vibratoPhaseDelay = rndNP1(&rng);
+  sp->attackTime = _pntr_app_sfx_cube(rndNP1(&rng));
+  sp->sustainTime = _pntr_app_sfx_square(rndNP1(&rng));
+  sp->decayTime = rndNP1(&rng);
+  sp->sustainPunch = _pntr_app_sfx_square(frnd(&rng, 0.8f));
 
   if (sp->attackTime + sp->sustainTime + sp->decayTime < 0.2f) {
-    sp->sustainTime += 0.2f + frnd(app, 0.3f);
-    sp->decayTime += 0.2f + frnd(app, 0.3f);
+    sp->sustainTime += 0.2f + frnd(&rng, 0.3f);
+    sp->decayTime += 0.2f + frnd(&rng, 0.3f);
   }
 
-  sp->lpfResonance = rndNP1(app);
-  sp->lpfCutoff = 1.0f - PNTR_POW(frnd(app, 1.0f), 3.0f);
-  sp->lpfCutoffSweep = PNTR_POW(rndNP1(app), 3.0f);
+  sp->lpfResonance = rndNP1(&rng);
+  sp->lpfCutoff = 1.0f - _pntr_app_sfx_cube(frnd(&rng, 1.0f));
+  sp->lpfCutoffSweep = _pntr_app_sfx_cube(rndNP1(&rng));
 
   if (sp->lpfCutoff < 0.1f && sp->lpfCutoffSweep < -0.05f) {
     sp->lpfCutoffSweep = -sp->lpfCutoffSweep;
   }
 
-  sp->hpfCutoff = PNTR_POW(frnd(app, 1.0f), 5.0f);
-  sp->hpfCutoffSweep = PNTR_POW(rndNP1(app), 5.0f);
-  sp->phaserOffset = PNTR_POW(rndNP1(app), 3.0f);
-  sp->phaserSweep = PNTR_POW(rndNP1(app), 3.0f);
-  sp->repeatSpeed = rndNP1(app);
-  sp->changeSpeed = rndNP1(app);
-  sp->changeAmount = rndNP1(app);
+  sp->hpfCutoff = _pntr_app_sfx_pow5(frnd(&rng, 1.0f));
+  sp->hpfCutoffSweep = _pntr_app_sfx_pow5(rndNP1(&rng));
+  sp->phaserOffset = _pntr_app_sfx_cube(rndNP1(&rng));
+  sp->phaserSweep = _pntr_app_sfx_cube(rndNP1(&rng));
+  sp->repeatSpeed = rndNP1(&rng);
+  sp->changeSpeed = rndNP1(&rng);
+  sp->changeAmount = rndNP1(&rng);
 }
 
 void pntr_app_sfx_mutate(pntr_app* app, SfxParams* sp, float range, uint32_t mask) {
@@ -952,13 +3103,16 @@ void pntr_app_sfx_mutate(pntr_app* app, SfxParams* sp, float range, uint32_t mas
   float val, low;
   uint32_t rmod, bit;
   int i;
+  // Like the presets, a NULL app mutates deterministically from sp->randSeed,
+  // and advances it below so repeated calls walk in random directions.
+  uint32_t rng = _pntr_app_sfx_seed_rand((app != NULL) ? (uint32_t)pntr_app_random(app, 0, 0xFFFFFF) : sp->randSeed);
 
-  rmod = 1 + sfx_random(app, 0xFFFFFF);
+  rmod = 1 + sfx_random(&rng, 0xFFFFFF);
   for (i = 0; i < 22; ++i) {
     bit = 1 << i;
     if ((rmod & bit) & mask) {
       low = (SFX_NEGATIVE_ONE_MASK & bit) ? -1.0f : 0.0f;
-      val = *valPtr + frnd(app, range) - half;
+      val = *valPtr + frnd(&rng, range) - half;
       if (val > 1.0f)
         val = 1.0f;
       else if (val < low)
@@ -967,40 +3121,1542 @@ void pntr_app_sfx_mutate(pntr_app* app, SfxParams* sp, float range, uint32_t mas
     }
     ++valPtr;
   }
+
+  if (app == NULL) {
+    sp->randSeed = rng;
+  }
+}
+
+// Fill in a mono PCM RIFF header for sampleCount samples.
+static void _pntr_app_sfx_wav_header(RIFF_header* header, int format, int sampleRate, int sampleCount) {
+  int bytesPerSample = format == SFX_F32 ? 4 : format == SFX_I16 ? 2 : 1;
+
+  PNTR_MEMCPY(header->riff_header, "RIFF", 4);
+  PNTR_MEMCPY(header->wave_header, "WAVE", 4);
+  PNTR_MEMCPY(header->fmt_header, "fmt ", 4);
+  PNTR_MEMCPY(header->data_header, "data", 4);
+  header->fmt_chunk_size = 16;
+  header->audio_format = format == SFX_F32 ? 3 : 1;
+  header->num_channels = 1;
+  header->sample_rate = sampleRate;
+  header->byte_rate = sampleRate * bytesPerSample;
+  header->sample_alignment = (int16_t)bytesPerSample;
+  header->bit_depth = (int16_t)(bytesPerSample * 8);
+  header->data_bytes = sampleCount * bytesPerSample;
+  header->wav_size = header->data_bytes + (int32_t)sizeof(RIFF_header) - 8;
+}
+
+// Allocate wave->data for params in wave->sampleFormat, and start rendering
+// it with state and modes. Return the most samples the sound can have, or -1
+// when out of memory.
+static int _pntr_app_sfx_begin_wav(const SfxParams* params, SfxSynthState* state, SfxWave* wave, const _SfxModes* modes) {
+  int bytesPerSample = wave->sampleFormat == SFX_F32 ? 4 : wave->sampleFormat == SFX_I16 ? 2 : 1;
+
+  if (wave->sampleRate <= 0) {
+    wave->sampleRate = 44100;
+  }
+  if (wave->sampleRate > PNTR_APP_SFX_MAX_SAMPLE_RATE) {
+    wave->data = NULL;
+    return -1;
+  }
+
+  // Allocate just what the sound needs, up to 10 seconds.
+  int maxSamples = pntr_app_sfx_sample_count_ex(params, wave->sampleRate);
+  if (maxSamples > wave->sampleRate * 10) {
+    maxSamples = wave->sampleRate * 10;
+  }
+
+  // Samples are rendered in place, behind room for the header.
+  wave->data = (unsigned char*)PNTR_MALLOC(sizeof(RIFF_header) + (size_t)maxSamples * bytesPerSample);
+  wave->sampleCount = 0;
+  wave->size = 0;
+  if (wave->data == NULL) {
+    return -1;
+  }
+  _pntr_app_sfx_count_allocation();
+
+  pntr_app_sfx_compile_ex(params, &state->patch, wave->sampleRate);
+  _pntr_app_sfx_begin_render_modes(state, &state->patch, wave->sampleFormat, modes);
+  state->supersample = wave->supersample;
+  return maxSamples;
+}
+
+// Fill in the size and WAV header of wave, once wave->sampleCount samples are rendered.
+static void _pntr_app_sfx_end_wav(SfxWave* wave) {
+  int bytesPerSample = wave->sampleFormat == SFX_F32 ? 4 : wave->sampleFormat == SFX_I16 ? 2 : 1;
+  RIFF_header wav_header;
+
+  wave->size = sizeof(RIFF_header) + (size_t)wave->sampleCount * bytesPerSample;
+  _pntr_app_sfx_wav_header(&wav_header, wave->sampleFormat, wave->sampleRate, wave->sampleCount);
+  PNTR_MEMCPY(wave->data, &wav_header, sizeof(RIFF_header));
+}
+
+// Render params into wave->data as a complete WAV file in wave->sampleFormat,
+// using state as scratch space. The settings come from modes, and pntr_app
+// is not used, so worker threads can call this with a snapshot of modes
+// taken on the thread that started them.
+static bool _pntr_app_sfx_render_wav(const SfxParams* params, SfxSynthState* state, SfxWave* wave, const _SfxModes* modes) {
+  int maxSamples = _pntr_app_sfx_begin_wav(params, state, wave, modes);
+
+  if (maxSamples < 0) {
+    return false;
+  }
+  wave->sampleCount = pntr_app_sfx_render(state, wave->data + sizeof(RIFF_header), maxSamples);
+  _pntr_app_sfx_end_wav(wave);
+  return true;
+}
+
+// Render params as a wave in format, and report the size of the wave data.
+static pntr_sound* _pntr_app_sfx_sound(SfxParams* params, int format, int sampleRate, size_t* bytes) {
+  SfxSynthState state;
+  SfxWave wave = {0};
+  SfxTraceEvent event;
+  _SfxModes modes;
+  uint64_t start;
+  bool ok;
+
+  wave.sampleFormat = format;
+  wave.sampleRate = sampleRate;
+  _pntr_app_sfx_get_modes(&modes);
+  start = _pntr_app_sfx_trace_start(&event, SFX_TRACE_SOUND, params, format, sampleRate);
+  ok = _pntr_app_sfx_render_wav(params, &state, &wave, &modes);
+  _pntr_app_sfx_trace_finish(&event, start, wave.sampleCount, wave.size);
+  if (!ok) {
+    pntr_set_error(PNTR_ERROR_NO_MEMORY);
+    return NULL;
+  }
+
+  if (bytes != NULL) {
+    *bytes = wave.size;
+  }
+  return pntr_app_sfx_load_wave_sound(&wave);
 }
 
 pntr_sound* pntr_app_sfx_sound(pntr_app* app, SfxParams* params) {
-  RIFF_header wav_header = {
-      .riff_header = "RIFF",
-      .wave_header = "WAVE",
-      .fmt_header = "fmt ",
-      .data_header = "data",
-      .fmt_chunk_size = 16,
-      .audio_format = 1,
-      .num_channels = 1,
-      .sample_rate = 44100,
-      .byte_rate = 44100,
-      .sample_alignment = 1,
-      .bit_depth = 8,
-
-      .wav_size = 0,
-      .data_bytes = 0};
-
-  SfxSynth* synth = pntr_app_sfx_alloc_synth(SFX_U8, 44100, 10);
-  int sampleCount = pntr_app_sfx_generate_wave(app, synth, params);
-
-  wav_header.wav_size = sampleCount;
-  wav_header.data_bytes = sampleCount;
-
-  unsigned char* w = PNTR_MALLOC(sampleCount + sizeof(wav_header));
-  PNTR_MEMCPY(w, &wav_header, sizeof(wav_header));
-  PNTR_MEMCPY((void*)((int64_t)w + sizeof(wav_header)), synth->samples.u8, sampleCount);
-
-  pntr_sound* s = pntr_load_sound_from_memory(PNTR_APP_SOUND_TYPE_WAV, w, sampleCount + sizeof(wav_header));
-  if (synth != NULL) {
-    PNTR_FREE(synth);
-  }
-  return s;
+  (void)app;
+  return _pntr_app_sfx_sound(params, SFX_U8, 44100, NULL);
+}
+
+/*
+ * Load params as a pntr_sound with format samples at sampleRate (44100
+ * when 0). PNTR_APP_SFX_NATIVE_FORMAT and the device rate skip the
+ * conversion the backend would otherwise do when loading the sound, and
+ * keep the full resolution of the synth instead of quantizing to 8 bits.
+ */
+pntr_sound* pntr_app_sfx_sound_ex(pntr_app* app, SfxParams* params, int format, int sampleRate) {
+  (void)app;
+  if (params == NULL || format < SFX_U8 || format > SFX_F32 || sampleRate < 0 || sampleRate > PNTR_APP_SFX_MAX_SAMPLE_RATE) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return NULL;
+  }
+  return _pntr_app_sfx_sound(params, format, sampleRate ? sampleRate : 44100, NULL);
+}
+
+/*
+ * Create an empty render cache. Sounds that are not in use are evicted,
+ * least recently used first, once the cached wave data is over maxBytes.
+ * Pass 0 for no limit.
+ *
+ * Unload it with pntr_app_sfx_unload_cache().
+ */
+SfxCache* pntr_app_sfx_load_cache(size_t maxBytes) {
+  SfxCache* cache = (SfxCache*)_pntr_app_sfx_malloc(sizeof(SfxCache));
+  if (cache == NULL) {
+    pntr_set_error(PNTR_ERROR_NO_MEMORY);
+    return NULL;
+  }
+
+  PNTR_MEMSET(cache, 0, sizeof(SfxCache));
+  cache->maxBytes = maxBytes;
+  return cache;
+}
+
+/*
+ * Unload a render cache and every sound in it, including sounds that
+ * were not released yet.
+ */
+void pntr_app_sfx_unload_cache(SfxCache* cache) {
+  int i;
+
+  if (cache == NULL) {
+    return;
+  }
+
+  for (i = 0; i < cache->count; i++) {
+    pntr_unload_sound(cache->entries[i].sound);
+  }
+  _SFX_STATS_LOCK();
+  _pntr_app_sfx_stats.bytesHeld -= cache->bytes;
+  _SFX_STATS_UNLOCK();
+  if (cache->entries != NULL) {
+    _pntr_app_sfx_free(cache->entries);
+  }
+  _pntr_app_sfx_free(cache);
+}
+
+// FNV-1a over the params, the output format, and the global settings that
+// change the samples: math mode, oscillator mode and silence trimming. The
+// SIMD level is left out, since every level renders the same samples.
+static uint64_t _pntr_app_sfx_hash_params(const SfxParams* params, int sampleFormat, int sampleRate) {
+  const unsigned char* bytes = (const unsigned char*)params;
+  uint64_t hash = 14695981039346656037ULL;
+  _SfxModes modes;
+  float silence[2];
+  size_t i;
+
+  for (i = 0; i < sizeof(SfxParams); i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  hash = (hash ^ (uint32_t)sampleFormat) * 1099511628211ULL;
+  hash = (hash ^ (uint32_t)sampleRate) * 1099511628211ULL;
+
+  _pntr_app_sfx_get_modes(&modes);
+  hash = (hash ^ (uint32_t)modes.math) * 1099511628211ULL;
+  hash = (hash ^ (uint32_t)modes.oscillator) * 1099511628211ULL;
+
+  silence[0] = modes.silenceThreshold;
+  silence[1] = modes.silenceHold;
+  bytes = (const unsigned char*)silence;
+  for (i = 0; i < sizeof(silence); i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Drop least recently used sounds that are not referenced until the cache fits maxBytes.
+static void _pntr_app_sfx_cache_evict(SfxCache* cache) {
+  int i, oldest;
+
+  while (cache->maxBytes != 0 && cache->bytes > cache->maxBytes) {
+    oldest = -1;
+    for (i = 0; i < cache->count; i++) {
+      if (cache->entries[i].refCount == 0 && (oldest < 0 || cache->entries[i].lastUsed < cache->entries[oldest].lastUsed)) {
+        oldest = i;
+      }
+    }
+    if (oldest < 0) {
+      // Everything left is in use.
+      return;
+    }
+
+    pntr_unload_sound(cache->entries[oldest].sound);
+    cache->bytes -= cache->entries[oldest].bytes;
+    _SFX_STATS_LOCK();
+    _pntr_app_sfx_stats.bytesHeld -= cache->entries[oldest].bytes;
+    _SFX_STATS_UNLOCK();
+    cache->entries[oldest] = cache->entries[--cache->count];
+    cache->evictions++;
+  }
+}
+
+/*
+ * Get the sound for params from the cache, rendering it on a miss.
+ * Byte-identical params share one pntr_sound, as long as the math,
+ * oscillator and silence settings are the same as when it was rendered.
+ *
+ * Every call must be matched by pntr_app_sfx_cache_release(), rather than
+ * pntr_unload_sound().
+ */
+pntr_sound* pntr_app_sfx_cache_sound(pntr_app* app, SfxCache* cache, SfxParams* params) {
+  return pntr_app_sfx_cache_sound_ex(app, cache, params, SFX_U8, 44100);
+}
+
+/*
+ * Like pntr_app_sfx_cache_sound(), for sounds with format samples at
+ * sampleRate (44100 when 0), as in pntr_app_sfx_sound_ex(). The same
+ * params in another format or rate are cached separately.
+ */
+pntr_sound* pntr_app_sfx_cache_sound_ex(pntr_app* app, SfxCache* cache, SfxParams* params, int format, int sampleRate) {
+  uint64_t hash;
+  SfxCacheEntry* entry;
+  pntr_sound* sound;
+  size_t bytes;
+  int i;
+
+  if (cache == NULL || params == NULL || format < SFX_U8 || format > SFX_F32 || sampleRate < 0 || sampleRate > PNTR_APP_SFX_MAX_SAMPLE_RATE) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return NULL;
+  }
+  if (sampleRate == 0) {
+    sampleRate = 44100;
+  }
+
+  hash = _pntr_app_sfx_hash_params(params, format, sampleRate);
+  cache->clock++;
+
+  for (i = 0; i < cache->count; i++) {
+    entry = &cache->entries[i];
+    if (entry->hash == hash && entry->sampleFormat == format && entry->sampleRate == sampleRate && PNTR_MEMCMP(&entry->params, params, sizeof(SfxParams)) == 0) {
+      entry->refCount++;
+      entry->lastUsed = cache->clock;
+      cache->hits++;
+      _SFX_STATS_LOCK();
+      _pntr_app_sfx_stats.cacheHits++;
+      _SFX_STATS_UNLOCK();
+      return entry->sound;
+    }
+  }
+
+  cache->misses++;
+  _SFX_STATS_LOCK();
+  _pntr_app_sfx_stats.cacheMisses++;
+  _SFX_STATS_UNLOCK();
+  (void)app;
+  sound = _pntr_app_sfx_sound(params, format, sampleRate, &bytes);
+  if (sound == NULL) {
+    return NULL;
+  }
+
+  if (cache->count == cache->capacity) {
+    int capacity = cache->capacity ? cache->capacity * 2 : 16;
+    SfxCacheEntry* entries = (SfxCacheEntry*)_pntr_app_sfx_malloc(sizeof(SfxCacheEntry) * capacity);
+    if (entries == NULL) {
+      pntr_unload_sound(sound);
+      pntr_set_error(PNTR_ERROR_NO_MEMORY);
+      return NULL;
+    }
+    if (cache->entries != NULL) {
+      PNTR_MEMCPY(entries, cache->entries, sizeof(SfxCacheEntry) * cache->count);
+      _pntr_app_sfx_free(cache->entries);
+    }
+    cache->entries = entries;
+    cache->capacity = capacity;
+  }
+
+  entry = &cache->entries[cache->count++];
+  entry->hash = hash;
+  entry->params = *params;
+  entry->sampleFormat = format;
+  entry->sampleRate = sampleRate;
+  entry->sound = sound;
+  entry->bytes = bytes;
+  entry->refCount = 1;
+  entry->lastUsed = cache->clock;
+  cache->bytes += bytes;
+  _SFX_STATS_LOCK();
+  _pntr_app_sfx_stats.bytesHeld += bytes;
+  _SFX_STATS_UNLOCK();
+
+  _pntr_app_sfx_cache_evict(cache);
+  return sound;
+}
+
+/*
+ * Release a sound from pntr_app_sfx_cache_sound(). It stays cached until
+ * it is evicted or the cache is unloaded.
+ */
+void pntr_app_sfx_cache_release(SfxCache* cache, pntr_sound* sound) {
+  int i;
+
+  if (cache == NULL || sound == NULL) {
+    return;
+  }
+
+  for (i = 0; i < cache->count; i++) {
+    if (cache->entries[i].sound == sound) {
+      if (cache->entries[i].refCount > 0) {
+        cache->entries[i].refCount--;
+      }
+      break;
+    }
+  }
+  _pntr_app_sfx_cache_evict(cache);
+}
+
+/*
+ * Hand a rendered wave to pntr_app as a pntr_sound. pntr_app takes
+ * ownership of the wave data, so wave->data is cleared.
+ */
+pntr_sound* pntr_app_sfx_load_wave_sound(SfxWave* wave) {
+  unsigned char* data;
+
+  if (wave == NULL || wave->data == NULL) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return NULL;
+  }
+
+  data = wave->data;
+  wave->data = NULL;
+  return pntr_load_sound_from_memory(PNTR_APP_SOUND_TYPE_WAV, data, (unsigned int)wave->size);
+}
+
+/*
+ * Free the data of a rendered wave that was not loaded as a sound.
+ */
+void pntr_app_sfx_unload_wave(SfxWave* wave) {
+  if (wave != NULL && wave->data != NULL) {
+    PNTR_FREE(wave->data);
+    wave->data = NULL;
+  }
+}
+
+// Shared work queue of pntr_app_sfx_render_batch().
+typedef struct _SfxBatch {
+  const SfxParams* params;
+  SfxWave* outputs;
+  int* order;  // Item indices, longest sound first
+  int count;
+  int next;    // Next position in order to render
+  int rendered;
+  _SfxModes modes;  // Settings of the calling thread, for every item
+#ifdef PNTR_APP_SFX_THREADS
+  pthread_mutex_t lock;
+#endif
+} _SfxBatch;
+
+// Each worker takes the next item until the queue is empty, so a long
+// explosion only holds up the worker rendering it.
+static void _pntr_app_sfx_batch_work(_SfxBatch* batch, SfxSynthState* state) {
+  SfxWave* wave;
+  SfxTraceEvent event;
+  uint64_t start;
+  int i, ok;
+
+  for (;;) {
+#ifdef PNTR_APP_SFX_THREADS
+    pthread_mutex_lock(&batch->lock);
+#endif
+    i = batch->next < batch->count ? batch->order[batch->next++] : -1;
+#ifdef PNTR_APP_SFX_THREADS
+    pthread_mutex_unlock(&batch->lock);
+#endif
+    if (i < 0) {
+      return;
+    }
+
+    wave = &batch->outputs[i];
+    start = _pntr_app_sfx_trace_start(&event, SFX_TRACE_BATCH, &batch->params[i], wave->sampleFormat, wave->sampleRate > 0 ? wave->sampleRate : 44100);
+    ok = _pntr_app_sfx_render_wav(&batch->params[i], state, wave, &batch->modes);
+    _pntr_app_sfx_trace_finish(&event, start, wave->sampleCount, wave->size);
+    wave->renderNs = event.renderNs;
+
+#ifdef PNTR_APP_SFX_THREADS
+    pthread_mutex_lock(&batch->lock);
+#endif
+    batch->rendered += ok;
+#ifdef PNTR_APP_SFX_THREADS
+    pthread_mutex_unlock(&batch->lock);
+#endif
+  }
+}
+
+#ifdef PNTR_APP_SFX_THREADS
+typedef struct _SfxBatchWorker {
+  _SfxBatch* batch;
+  pthread_t thread;
+  SfxSynthState* state;  // Pooled scratch space of this worker
+} _SfxBatchWorker;
+
+static void* _pntr_app_sfx_batch_thread(void* arg) {
+  _SfxBatchWorker* worker = (_SfxBatchWorker*)arg;
+  _pntr_app_sfx_batch_work(worker->batch, worker->state);
+  return NULL;
+}
+#endif  // PNTR_APP_SFX_THREADS
+
+/*
+ * Render many sounds at once, as WAV files in outputs[0..count-1]. Set each
+ * output's sampleFormat first, or zero them for 8-bit sounds.
+ *
+ * With PNTR_APP_SFX_ENABLE_THREADS, the work is spread over up to threads
+ * threads, including the calling one. Otherwise everything is rendered on
+ * the calling thread. Longer sounds are started first. Every sound uses the
+ * SIMD, math, oscillator and silence settings of the calling thread.
+ *
+ * Turn outputs into sounds with pntr_app_sfx_load_wave_sound(), or free them
+ * with pntr_app_sfx_unload_wave().
+ *
+ * Return the number of sounds rendered.
+ */
+int pntr_app_sfx_render_batch(const SfxParams* params, int count, SfxWave* outputs, int threads) {
+  _SfxBatch batch;
+  SfxSynthState* state;
+  int* lengths;
+  int i, j, key, keyLength;
+
+  if (params == NULL || outputs == NULL || count < 0) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return 0;
+  }
+  if (count == 0) {
+    return 0;
+  }
+
+  // Scratch space for the calling thread, from the pool.
+  state = (SfxSynthState*)_pntr_app_sfx_pool_take(&_pntr_app_sfx_state_pool, sizeof(SfxSynthState));
+  batch.order = (int*)_pntr_app_sfx_malloc(sizeof(int) * count * 2);
+  if (state == NULL || batch.order == NULL) {
+    _pntr_app_sfx_pool_give(&_pntr_app_sfx_state_pool, state);
+    _pntr_app_sfx_free(batch.order);
+    pntr_set_error(PNTR_ERROR_NO_MEMORY);
+    return 0;
+  }
+  lengths = batch.order + count;
+
+  // Sort longest first, so the long renders do not end up last in the queue.
+  for (i = 0; i < count; i++) {
+    key = i;
+    keyLength = pntr_app_sfx_sample_count_ex(&params[i], outputs[i].sampleRate);
+    for (j = i; j > 0 && lengths[j - 1] < keyLength; j--) {
+      batch.order[j] = batch.order[j - 1];
+      lengths[j] = lengths[j - 1];
+    }
+    batch.order[j] = key;
+    lengths[j] = keyLength;
+
+    outputs[i].data = NULL;
+    outputs[i].size = 0;
+    outputs[i].sampleCount = 0;
+    outputs[i].renderNs = 0;
+  }
+
+  batch.params = params;
+  batch.outputs = outputs;
+  batch.count = count;
+  batch.next = 0;
+  batch.rendered = 0;
+  _pntr_app_sfx_get_modes(&batch.modes);
+
+#ifdef PNTR_APP_SFX_THREADS
+  pthread_mutex_init(&batch.lock, NULL);
+  if (threads > count) {
+    threads = count;
+  }
+  if (threads > 1) {
+    _SfxBatchWorker* workers = (_SfxBatchWorker*)_pntr_app_sfx_malloc(sizeof(_SfxBatchWorker) * threads);
+    if (workers != NULL) {
+      int started = 0;
+
+      for (i = 1; i < threads; i++) {
+        _SfxBatchWorker* worker = &workers[started];
+        worker->batch = &batch;
+        worker->state = (SfxSynthState*)_pntr_app_sfx_pool_take(&_pntr_app_sfx_state_pool, sizeof(SfxSynthState));
+        if (worker->state == NULL) {
+          break;
+        }
+        if (pthread_create(&worker->thread, NULL, _pntr_app_sfx_batch_thread, worker) == 0) {
+          started++;
+        } else {
+          _pntr_app_sfx_pool_give(&_pntr_app_sfx_state_pool, worker->state);
+        }
+      }
+
+      // The calling thread works too.
+      _pntr_app_sfx_batch_work(&batch, state);
+
+      for (i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        _pntr_app_sfx_pool_give(&_pntr_app_sfx_state_pool, workers[i].state);
+      }
+      _pntr_app_sfx_free(workers);
+      pthread_mutex_destroy(&batch.lock);
+      _pntr_app_sfx_pool_give(&_pntr_app_sfx_state_pool, state);
+      _pntr_app_sfx_free(batch.order);
+      return batch.rendered;
+    }
+  }
+#else
+  (void)threads;
+#endif
+
+  _pntr_app_sfx_batch_work(&batch, state);
+#ifdef PNTR_APP_SFX_THREADS
+  pthread_mutex_destroy(&batch.lock);
+#endif
+  _pntr_app_sfx_pool_give(&_pntr_app_sfx_state_pool, state);
+  _pntr_app_sfx_free(batch.order);
+  return batch.rendered;
+}
+
+// Samples rendered by each pntr_app_sfx_async_ready() call without threads,
+// and between checks for cancellation on a worker thread.
+#ifndef PNTR_APP_SFX_ASYNC_STEP
+#define PNTR_APP_SFX_ASYNC_STEP 2048
+#endif
+
+// Most worker threads rendering background sounds at once. More sounds wait
+// in a queue, oldest first.
+#ifndef PNTR_APP_SFX_ASYNC_THREADS
+#define PNTR_APP_SFX_ASYNC_THREADS 2
+#endif
+
+struct SfxAsyncSound {
+  SfxParams params;
+  SfxWave wave;              // Rendered in place, like _pntr_app_sfx_render_wav()
+  int maxSamples;
+  uint64_t renderNs;         // Time spent rendering so far
+  SfxTraceEvent event;
+  bool ready;                // Rendering is over, and sound is loaded (main thread only)
+  pntr_sound* sound;         // NULL once handed over, or if it could not be loaded
+  SfxSoundCallback callback;
+  void* userData;
+  SfxAsyncSound* next;       // Pending callback renders, for pntr_app_sfx_update_async()
+#ifdef PNTR_APP_SFX_THREADS
+  bool threaded;             // Rendered by the worker threads, not by pntr_app_sfx_async_ready()
+  SfxAsyncSound* queued;     // Next sound waiting for a worker
+  int running;               // Taken by a worker, under the async lock
+  int done;                  // Set by the worker when rendering is over, under the async lock
+  int cancel;                // Set to stop the worker early, under the async lock
+#endif
+  SfxSynthState state;
+};
+
+// Renders with a callback, oldest first.
+static SfxAsyncSound* _pntr_app_sfx_async_pending = NULL;
+
+// Render up to frames more samples of async, and return true once it is complete.
+static bool _pntr_app_sfx_async_step(SfxAsyncSound* async, int frames) {
+  int bytesPerSample = async->wave.sampleFormat == SFX_F32 ? 4 : async->wave.sampleFormat == SFX_I16 ? 2 : 1;
+  uint64_t start = _pntr_app_sfx_time_ns();
+
+  if (frames > async->maxSamples - async->wave.sampleCount) {
+    frames = async->maxSamples - async->wave.sampleCount;
+  }
+  async->wave.sampleCount += pntr_app_sfx_render(&async->state, async->wave.data + sizeof(RIFF_header) + (size_t)async->wave.sampleCount * bytesPerSample, frames);
+  async->renderNs += _pntr_app_sfx_time_ns() - start;
+  return async->state.finished || async->wave.sampleCount >= async->maxSamples;
+}
+
+#ifdef PNTR_APP_SFX_THREADS
+// Sounds waiting for a worker, oldest first, and the number of workers. The
+// lock also guards the running, done and cancel flags of every sound.
+static SfxAsyncSound* _pntr_app_sfx_async_queue = NULL;
+static int _pntr_app_sfx_async_workers = 0;
+static pthread_mutex_t _pntr_app_sfx_async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _pntr_app_sfx_async_finished = PTHREAD_COND_INITIALIZER;
+
+// Render queued sounds until the queue is empty, then end the thread.
+static void* _pntr_app_sfx_async_worker(void* arg) {
+  SfxAsyncSound* async;
+  bool complete;
+  int cancel;
+
+  (void)arg;
+  pthread_mutex_lock(&_pntr_app_sfx_async_lock);
+  while ((async = _pntr_app_sfx_async_queue) != NULL) {
+    _pntr_app_sfx_async_queue = async->queued;
+    async->running = 1;
+    pthread_mutex_unlock(&_pntr_app_sfx_async_lock);
+
+    complete = false;
+    while (!complete) {
+      pthread_mutex_lock(&_pntr_app_sfx_async_lock);
+      cancel = async->cancel;
+      pthread_mutex_unlock(&_pntr_app_sfx_async_lock);
+      if (cancel) {
+        break;
+      }
+      complete = _pntr_app_sfx_async_step(async, PNTR_APP_SFX_ASYNC_STEP);
+    }
+
+    // The sound can be unloaded as soon as done is set, so it is not touched after.
+    pthread_mutex_lock(&_pntr_app_sfx_async_lock);
+    async->done = 1;
+    pthread_cond_broadcast(&_pntr_app_sfx_async_finished);
+  }
+  _pntr_app_sfx_async_workers--;
+  pthread_mutex_unlock(&_pntr_app_sfx_async_lock);
+  return NULL;
+}
+
+// Queue async for the workers, starting one if fewer than
+// PNTR_APP_SFX_ASYNC_THREADS run. Return false when there is no worker.
+static bool _pntr_app_sfx_async_queue_sound(SfxAsyncSound* async) {
+  SfxAsyncSound** last = &_pntr_app_sfx_async_queue;
+  pthread_t thread;
+
+  pthread_mutex_lock(&_pntr_app_sfx_async_lock);
+  if (_pntr_app_sfx_async_workers < PNTR_APP_SFX_ASYNC_THREADS && pthread_create(&thread, NULL, _pntr_app_sfx_async_worker, NULL) == 0) {
+    pthread_detach(thread);
+    _pntr_app_sfx_async_workers++;
+  }
+  if (_pntr_app_sfx_async_workers == 0) {
+    pthread_mutex_unlock(&_pntr_app_sfx_async_lock);
+    return false;
+  }
+
+  while (*last != NULL) {
+    last = &(*last)->queued;
+  }
+  *last = async;
+  pthread_mutex_unlock(&_pntr_app_sfx_async_lock);
+  return true;
+}
+
+// Take async off the queue, or stop its worker and wait for it.
+static void _pntr_app_sfx_async_cancel(SfxAsyncSound* async) {
+  SfxAsyncSound** link = &_pntr_app_sfx_async_queue;
+
+  pthread_mutex_lock(&_pntr_app_sfx_async_lock);
+  if (!async->running) {
+    while (*link != async) {
+      link = &(*link)->queued;
+    }
+    *link = async->queued;
+  } else {
+    async->cancel = 1;
+    while (!async->done) {
+      pthread_cond_wait(&_pntr_app_sfx_async_finished, &_pntr_app_sfx_async_lock);
+    }
+  }
+  pthread_mutex_unlock(&_pntr_app_sfx_async_lock);
+}
+#endif  // PNTR_APP_SFX_THREADS
+
+// Set up a background render, on the worker threads when there are threads.
+static SfxAsyncSound* _pntr_app_sfx_start_async(SfxParams* params, int format, int sampleRate) {
+  SfxAsyncSound* async;
+  _SfxModes modes;
+
+  if (params == NULL || format < SFX_U8 || format > SFX_F32 || sampleRate < 0 || sampleRate > PNTR_APP_SFX_MAX_SAMPLE_RATE) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return NULL;
+  }
+
+  async = (SfxAsyncSound*)_pntr_app_sfx_pool_take(&_pntr_app_sfx_async_pool, sizeof(SfxAsyncSound));
+  if (async == NULL) {
+    pntr_set_error(PNTR_ERROR_NO_MEMORY);
+    return NULL;
+  }
+  PNTR_MEMSET(async, 0, offsetof(SfxAsyncSound, state));
+
+  // The params are copied, so they can change while the sound renders.
+  async->params = *params;
+  async->wave.sampleFormat = format;
+  async->wave.sampleRate = sampleRate;
+  _pntr_app_sfx_get_modes(&modes);
+  async->maxSamples = _pntr_app_sfx_begin_wav(&async->params, &async->state, &async->wave, &modes);
+  if (async->maxSamples < 0) {
+    _pntr_app_sfx_pool_give(&_pntr_app_sfx_async_pool, async);
+    pntr_set_error(PNTR_ERROR_NO_MEMORY);
+    return NULL;
+  }
+  _pntr_app_sfx_trace_start(&async->event, SFX_TRACE_ASYNC, &async->params, format, async->wave.sampleRate);
+
+#ifdef PNTR_APP_SFX_THREADS
+  // Without a worker, pntr_app_sfx_async_ready() renders it a step at a time.
+  async->threaded = _pntr_app_sfx_async_queue_sound(async);
+#endif
+  return async;
+}
+
+/*
+ * Start rendering params as an 8-bit pntr_sound in the background, and
+ * return right away. Poll it with pntr_app_sfx_async_ready(), then take the
+ * sound with pntr_app_sfx_async_sound().
+ *
+ * With PNTR_APP_SFX_ENABLE_THREADS, the sound renders on one of up to
+ * PNTR_APP_SFX_ASYNC_THREADS (2) worker threads, which start as sounds are
+ * queued and end once none are left. Otherwise, each pntr_app_sfx_async_ready() call renders
+ * PNTR_APP_SFX_ASYNC_STEP more samples, so no single frame pays for a
+ * whole long sound.
+ *
+ * Unload it with pntr_app_sfx_unload_async().
+ */
+SfxAsyncSound* pntr_app_sfx_sound_async(pntr_app* app, SfxParams* params) {
+  return pntr_app_sfx_sound_async_ex(app, params, SFX_U8, 44100);
+}
+
+/*
+ * Like pntr_app_sfx_sound_async(), with format samples at sampleRate (44100
+ * when 0), as in pntr_app_sfx_sound_ex().
+ */
+SfxAsyncSound* pntr_app_sfx_sound_async_ex(pntr_app* app, SfxParams* params, int format, int sampleRate) {
+  (void)app;
+  return _pntr_app_sfx_start_async(params, format, sampleRate);
+}
+
+/*
+ * Check whether a background render is over, and load its sound if so.
+ * Call this from the thread that loads and plays sounds.
+ */
+bool pntr_app_sfx_async_ready(SfxAsyncSound* async) {
+  bool complete;
+
+  if (async == NULL) {
+    return false;
+  }
+  if (async->ready) {
+    return true;
+  }
+
+#ifdef PNTR_APP_SFX_THREADS
+  if (async->threaded) {
+    pthread_mutex_lock(&_pntr_app_sfx_async_lock);
+    complete = async->done != 0;
+    pthread_mutex_unlock(&_pntr_app_sfx_async_lock);
+  } else {
+    complete = _pntr_app_sfx_async_step(async, PNTR_APP_SFX_ASYNC_STEP);
+  }
+#else
+  complete = _pntr_app_sfx_async_step(async, PNTR_APP_SFX_ASYNC_STEP);
+#endif
+  if (!complete) {
+    return false;
+  }
+
+  // pntr_app backends load sounds on the main thread, so that happens here.
+  _pntr_app_sfx_end_wav(&async->wave);
+  _pntr_app_sfx_trace_finish(&async->event, _pntr_app_sfx_time_ns() - async->renderNs, async->wave.sampleCount, async->wave.size);
+  async->sound = pntr_app_sfx_load_wave_sound(&async->wave);
+  async->ready = true;
+  return true;
+}
+
+/*
+ * Take the sound of a background render once pntr_app_sfx_async_ready()
+ * says it is ready, or NULL before then. The caller owns the sound, and
+ * unloads it with pntr_unload_sound().
+ */
+pntr_sound* pntr_app_sfx_async_sound(SfxAsyncSound* async) {
+  pntr_sound* sound;
+
+  if (async == NULL || !async->ready) {
+    return NULL;
+  }
+  sound = async->sound;
+  async->sound = NULL;
+  return sound;
+}
+
+/*
+ * Unload a background render. One that is still rendering is stopped first,
+ * and a sound that was not taken is unloaded too.
+ */
+void pntr_app_sfx_unload_async(SfxAsyncSound* async) {
+  if (async == NULL) {
+    return;
+  }
+
+#ifdef PNTR_APP_SFX_THREADS
+  if (async->threaded) {
+    _pntr_app_sfx_async_cancel(async);
+  }
+#endif
+
+  if (async->sound != NULL) {
+    pntr_unload_sound(async->sound);
+  }
+  pntr_app_sfx_unload_wave(&async->wave);
+  _pntr_app_sfx_pool_give(&_pntr_app_sfx_async_pool, async);
+}
+
+/*
+ * Render params in the background like pntr_app_sfx_sound_async_ex(), and
+ * call callback with the sound once it is ready, from
+ * pntr_app_sfx_update_async(). The callback owns the sound, which is NULL
+ * if it could not be loaded.
+ *
+ * Return false if the render could not be started.
+ */
+bool pntr_app_sfx_sound_async_callback(pntr_app* app, SfxParams* params, int format, int sampleRate, SfxSoundCallback callback, void* userData) {
+  SfxAsyncSound* async;
+  SfxAsyncSound** last = &_pntr_app_sfx_async_pending;
+
+  (void)app;
+  if (callback == NULL) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return false;
+  }
+
+  async = _pntr_app_sfx_start_async(params, format, sampleRate);
+  if (async == NULL) {
+    return false;
+  }
+  async->callback = callback;
+  async->userData = userData;
+
+  while (*last != NULL) {
+    last = &(*last)->next;
+  }
+  *last = async;
+  return true;
+}
+
+/*
+ * Call the callbacks of the renders from pntr_app_sfx_sound_async_callback()
+ * that are ready, oldest first. Call this once per frame, from the thread
+ * that loads and plays sounds.
+ *
+ * Return the number of renders still pending.
+ */
+int pntr_app_sfx_update_async(void) {
+  SfxAsyncSound** link = &_pntr_app_sfx_async_pending;
+  SfxAsyncSound* async;
+  pntr_sound* sound;
+  int pending = 0;
+
+  while ((async = *link) != NULL) {
+    if (!pntr_app_sfx_async_ready(async)) {
+      link = &async->next;
+      pending++;
+      continue;
+    }
+
+    // Unlink it first, so the callback can start new renders.
+    *link = async->next;
+    sound = pntr_app_sfx_async_sound(async);
+    async->callback(sound, async->userData);
+    pntr_app_sfx_unload_async(async);
+  }
+  return pending;
+}
+
+/*
+ * Stop and unload every render from pntr_app_sfx_sound_async_callback()
+ * without calling its callback, like when closing the app.
+ */
+void pntr_app_sfx_cancel_async(void) {
+  SfxAsyncSound* async;
+
+  while ((async = _pntr_app_sfx_async_pending) != NULL) {
+    _pntr_app_sfx_async_pending = async->next;
+    pntr_app_sfx_unload_async(async);
+  }
+}
+
+// How SfxBank.data is held.
+#define _SFX_BANK_BORROWED 0
+#define _SFX_BANK_LOADED 1
+#define _SFX_BANK_MAPPED 2
+
+// Bank files are little-endian on every host, so their fields are read and
+// written a byte at a time rather than copied as structs.
+static uint16_t _pntr_app_sfx_read_u16(const unsigned char* bytes) {
+  return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+static uint32_t _pntr_app_sfx_read_u32(const unsigned char* bytes) {
+  return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static void _pntr_app_sfx_write_u16(unsigned char* bytes, uint16_t value) {
+  bytes[0] = (unsigned char)value;
+  bytes[1] = (unsigned char)(value >> 8);
+}
+
+static void _pntr_app_sfx_write_u32(unsigned char* bytes, uint32_t value) {
+  bytes[0] = (unsigned char)value;
+  bytes[1] = (unsigned char)(value >> 8);
+  bytes[2] = (unsigned char)(value >> 16);
+  bytes[3] = (unsigned char)(value >> 24);
+}
+
+static void _pntr_app_sfx_read_bank_header(const unsigned char* bytes, SfxBankHeader* header) {
+  PNTR_MEMCPY(header->signature, bytes, 4);
+  header->version = _pntr_app_sfx_read_u16(bytes + offsetof(SfxBankHeader, version));
+  header->entrySize = _pntr_app_sfx_read_u16(bytes + offsetof(SfxBankHeader, entrySize));
+  header->count = _pntr_app_sfx_read_u32(bytes + offsetof(SfxBankHeader, count));
+  header->reserved = _pntr_app_sfx_read_u32(bytes + offsetof(SfxBankHeader, reserved));
+}
+
+static void _pntr_app_sfx_write_bank_header(unsigned char* bytes, const SfxBankHeader* header) {
+  PNTR_MEMCPY(bytes, header->signature, 4);
+  _pntr_app_sfx_write_u16(bytes + offsetof(SfxBankHeader, version), header->version);
+  _pntr_app_sfx_write_u16(bytes + offsetof(SfxBankHeader, entrySize), header->entrySize);
+  _pntr_app_sfx_write_u32(bytes + offsetof(SfxBankHeader, count), header->count);
+  _pntr_app_sfx_write_u32(bytes + offsetof(SfxBankHeader, reserved), header->reserved);
+}
+
+static void _pntr_app_sfx_read_bank_entry(const unsigned char* bytes, SfxBankEntry* entry) {
+  PNTR_MEMCPY(entry->name, bytes, SFX_BANK_NAME_LENGTH);
+  entry->paramsOffset = _pntr_app_sfx_read_u32(bytes + offsetof(SfxBankEntry, paramsOffset));
+  entry->waveOffset = _pntr_app_sfx_read_u32(bytes + offsetof(SfxBankEntry, waveOffset));
+  entry->waveSize = _pntr_app_sfx_read_u32(bytes + offsetof(SfxBankEntry, waveSize));
+  entry->reserved = _pntr_app_sfx_read_u32(bytes + offsetof(SfxBankEntry, reserved));
+}
+
+static void _pntr_app_sfx_write_bank_entry(unsigned char* bytes, const SfxBankEntry* entry) {
+  PNTR_MEMCPY(bytes, entry->name, SFX_BANK_NAME_LENGTH);
+  _pntr_app_sfx_write_u32(bytes + offsetof(SfxBankEntry, paramsOffset), entry->paramsOffset);
+  _pntr_app_sfx_write_u32(bytes + offsetof(SfxBankEntry, waveOffset), entry->waveOffset);
+  _pntr_app_sfx_write_u32(bytes + offsetof(SfxBankEntry, waveSize), entry->waveSize);
+  _pntr_app_sfx_write_u32(bytes + offsetof(SfxBankEntry, reserved), entry->reserved);
+}
+
+// SfxParams records are their 32-bit fields (randSeed, waveType and floats) in order.
+static void _pntr_app_sfx_read_bank_params(const unsigned char* bytes, SfxParams* params) {
+  uint32_t words[sizeof(SfxParams) / 4];
+  size_t i;
+
+  for (i = 0; i < sizeof(SfxParams) / 4; i++) {
+    words[i] = _pntr_app_sfx_read_u32(bytes + i * 4);
+  }
+  PNTR_MEMCPY(params, words, sizeof(SfxParams));
+}
+
+static void _pntr_app_sfx_write_bank_params(unsigned char* bytes, const SfxParams* params) {
+  uint32_t words[sizeof(SfxParams) / 4];
+  size_t i;
+
+  PNTR_MEMCPY(words, params, sizeof(SfxParams));
+  for (i = 0; i < sizeof(SfxParams) / 4; i++) {
+    _pntr_app_sfx_write_u32(bytes + i * 4, words[i]);
+  }
+}
+
+static SfxBank* _pntr_app_sfx_open_bank(const unsigned char* data, size_t size, int storage) {
+  SfxBankHeader header;
+  SfxBank* bank;
+
+  if (data == NULL || size < sizeof(SfxBankHeader)) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return NULL;
+  }
+
+  _pntr_app_sfx_read_bank_header(data, &header);
+  if (header.signature[0] != 'r' || header.signature[1] != 'F' || header.signature[2] != 'X' || header.signature[3] != 'B' ||
+      header.version != 100 || header.entrySize != sizeof(SfxBankEntry) ||
+      header.count > (size - sizeof(SfxBankHeader)) / sizeof(SfxBankEntry)) {
+    pntr_set_error(PNTR_ERROR_FAILED_TO_OPEN);
+    return NULL;
+  }
+
+  bank = (SfxBank*)_pntr_app_sfx_malloc(sizeof(SfxBank) + sizeof(pntr_sound*) * header.count);
+  if (bank == NULL) {
+    pntr_set_error(PNTR_ERROR_NO_MEMORY);
+    return NULL;
+  }
+
+  // Entries are only checked when they are used, so opening is O(1).
+  bank->count = (int)header.count;
+  bank->data = data;
+  bank->size = size;
+  bank->storage = storage;
+  bank->sounds = (pntr_sound**)(bank + 1);
+  bank->bytes = 0;
+  PNTR_MEMSET(bank->sounds, 0, sizeof(pntr_sound*) * header.count);
+  return bank;
+}
+
+/*
+ * Open a packed sound bank file, made with pntr_app_sfx_save_bank(). The file
+ * is memory-mapped where possible, so nothing is read until it is used.
+ */
+SfxBank* pntr_app_sfx_load_bank(const char* fileName) {
+  SfxBank* bank;
+
+  if (fileName == NULL) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return NULL;
+  }
+
+#ifdef PNTR_APP_SFX_MMAP
+  {
+    struct stat st;
+    void* map;
+    int fd = open(fileName, O_RDONLY);
+    if (fd >= 0) {
+      map = MAP_FAILED;
+      if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      }
+      close(fd);
+      if (map != MAP_FAILED) {
+        bank = _pntr_app_sfx_open_bank((const unsigned char*)map, (size_t)st.st_size, _SFX_BANK_MAPPED);
+        if (bank == NULL) {
+          munmap(map, (size_t)st.st_size);
+        }
+        return bank;
+      }
+    }
+  }
+#endif  // PNTR_APP_SFX_MMAP
+
+  // Fall back to reading the whole file, which also covers virtual file systems.
+  unsigned int bytesRead;
+  unsigned char* fileData = pntr_load_file(fileName, &bytesRead);
+  if (fileData == NULL) {
+    return NULL;
+  }
+
+  bank = _pntr_app_sfx_open_bank(fileData, bytesRead, _SFX_BANK_LOADED);
+  if (bank == NULL) {
+    pntr_unload_file(fileData);
+  }
+  return bank;
+}
+
+/*
+ * Open a sound bank that is already in memory, such as one embedded in the
+ * executable. The data is not copied, and must outlive the bank.
+ */
+SfxBank* pntr_app_sfx_load_bank_from_memory(const void* data, size_t size) {
+  return _pntr_app_sfx_open_bank((const unsigned char*)data, size, _SFX_BANK_BORROWED);
+}
+
+/*
+ * Close a sound bank, and unload every sound resolved from it.
+ */
+void pntr_app_sfx_unload_bank(SfxBank* bank) {
+  if (bank == NULL) {
+    return;
+  }
+
+  for (int i = 0; i < bank->count; i++) {
+    if (bank->sounds[i] != NULL) {
+      pntr_unload_sound(bank->sounds[i]);
+    }
+  }
+  _SFX_STATS_LOCK();
+  _pntr_app_sfx_stats.bytesHeld -= bank->bytes;
+  _SFX_STATS_UNLOCK();
+
+#ifdef PNTR_APP_SFX_MMAP
+  if (bank->storage == _SFX_BANK_MAPPED) {
+    munmap((void*)bank->data, bank->size);
+  }
+#endif  // PNTR_APP_SFX_MMAP
+  if (bank->storage == _SFX_BANK_LOADED) {
+    pntr_unload_file((unsigned char*)bank->data);
+  }
+
+  _pntr_app_sfx_free(bank);
+}
+
+// Read and bounds-check the entry of a sound.
+static bool _pntr_app_sfx_bank_entry(SfxBank* bank, int id, SfxBankEntry* entry) {
+  if (bank == NULL || id < 0 || id >= bank->count) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return false;
+  }
+
+  _pntr_app_sfx_read_bank_entry(bank->data + sizeof(SfxBankHeader) + sizeof(SfxBankEntry) * id, entry);
+  if (entry->paramsOffset > bank->size || bank->size - entry->paramsOffset < sizeof(SfxParams) ||
+      entry->waveOffset > bank->size || bank->size - entry->waveOffset < entry->waveSize) {
+    pntr_set_error(PNTR_ERROR_FAILED_TO_OPEN);
+    return false;
+  }
+  return true;
+}
+
+// Compare names the way they are stored: up to SFX_BANK_NAME_LENGTH - 1 characters.
+static int _pntr_app_sfx_bank_compare(const char* a, const char* b) {
+  for (int i = 0; i < SFX_BANK_NAME_LENGTH - 1; i++) {
+    if (a[i] != b[i]) {
+      return (unsigned char)a[i] < (unsigned char)b[i] ? -1 : 1;
+    }
+    if (a[i] == '\0') {
+      return 0;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Find the id of a sound by name, with a binary search of the index. Like
+ * stored names, name is compared up to SFX_BANK_NAME_LENGTH - 1 characters.
+ *
+ * Return -1 if the bank has no sound of that name.
+ */
+int pntr_app_sfx_bank_find(SfxBank* bank, const char* name) {
+  const char* names;
+  int low = 0, high, mid, order;
+
+  if (bank == NULL || name == NULL) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return -1;
+  }
+
+  names = (const char*)bank->data + sizeof(SfxBankHeader);
+  high = bank->count - 1;
+  while (low <= high) {
+    mid = low + (high - low) / 2;
+    order = _pntr_app_sfx_bank_compare(name, names + sizeof(SfxBankEntry) * mid);
+    if (order == 0) {
+      return mid;
+    }
+    if (order < 0) {
+      high = mid - 1;
+    } else {
+      low = mid + 1;
+    }
+  }
+  return -1;
+}
+
+/*
+ * Copy the parameters of a sound in the bank.
+ */
+bool pntr_app_sfx_bank_params(SfxBank* bank, int id, SfxParams* params) {
+  SfxBankEntry entry;
+
+  if (params == NULL || !_pntr_app_sfx_bank_entry(bank, id, &entry)) {
+    return false;
+  }
+
+  _pntr_app_sfx_read_bank_params(bank->data + entry.paramsOffset, params);
+  return true;
+}
+
+/*
+ * Get a sound from the bank. Sounds are resolved the first time they are
+ * asked for: pre-rendered ones are loaded as they are, the rest are rendered
+ * from their parameters. The bank owns the sound, so do not unload it.
+ */
+pntr_sound* pntr_app_sfx_bank_sound(pntr_app* app, SfxBank* bank, int id) {
+  SfxBankEntry entry;
+  SfxParams params;
+  unsigned char* wave;
+  size_t bytes = 0;
+
+  (void)app;
+  if (!_pntr_app_sfx_bank_entry(bank, id, &entry)) {
+    return NULL;
+  }
+  if (bank->sounds[id] != NULL) {
+    return bank->sounds[id];
+  }
+
+  if (entry.waveOffset != 0 && entry.waveSize > sizeof(RIFF_header)) {
+    // pntr_app takes ownership of the data it loads, so hand it a copy.
+    wave = (unsigned char*)PNTR_MALLOC(entry.waveSize);
+    if (wave == NULL) {
+      pntr_set_error(PNTR_ERROR_NO_MEMORY);
+      return NULL;
+    }
+    _pntr_app_sfx_count_allocation();
+    PNTR_MEMCPY(wave, bank->data + entry.waveOffset, entry.waveSize);
+    bank->sounds[id] = pntr_load_sound_from_memory(PNTR_APP_SOUND_TYPE_WAV, wave, entry.waveSize);
+    bytes = entry.waveSize;
+  } else {
+    _pntr_app_sfx_read_bank_params(bank->data + entry.paramsOffset, &params);
+    bank->sounds[id] = _pntr_app_sfx_sound(&params, SFX_U8, 44100, &bytes);
+  }
+
+  // The bank holds the sound until it is unloaded, like a render cache.
+  if (bank->sounds[id] != NULL) {
+    bank->bytes += bytes;
+    _SFX_STATS_LOCK();
+    _pntr_app_sfx_stats.bytesHeld += bytes;
+    _SFX_STATS_UNLOCK();
+  }
+  return bank->sounds[id];
+}
+
+/*
+ * Pack sounds into a bank file. Names longer than SFX_BANK_NAME_LENGTH - 1
+ * characters are truncated. With prerender, the 8-bit WAV of every sound is
+ * stored too, so loading it skips synthesis.
+ */
+bool pntr_app_sfx_save_bank(const char* fileName, const char* const* names, const SfxParams* params, int count, bool prerender) {
+  SfxBankHeader header = {{'r', 'F', 'X', 'B'}, 100, sizeof(SfxBankEntry), 0, 0};
+  SfxBankEntry entry;
+  SfxWave* waves = NULL;
+  unsigned char* fileData;
+  int* order;
+  size_t size, waveOffset;
+  int i, j, key;
+  bool result;
+
+  if (fileName == NULL || names == NULL || params == NULL || count < 0) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return false;
+  }
+
+  order = (int*)_pntr_app_sfx_malloc(sizeof(int) * (count + 1));
+  if (order == NULL) {
+    pntr_set_error(PNTR_ERROR_NO_MEMORY);
+    return false;
+  }
+
+  // The index is sorted by name, for pntr_app_sfx_bank_find().
+  for (i = 0; i < count; i++) {
+    key = i;
+    for (j = i; j > 0 && _pntr_app_sfx_bank_compare(names[key], names[order[j - 1]]) < 0; j--) {
+      order[j] = order[j - 1];
+    }
+    order[j] = key;
+  }
+
+  size = sizeof(SfxBankHeader) + (sizeof(SfxBankEntry) + sizeof(SfxParams)) * count;
+  if (prerender && count > 0) {
+    waves = (SfxWave*)_pntr_app_sfx_malloc(sizeof(SfxWave) * count);
+    if (waves == NULL) {
+      _pntr_app_sfx_free(order);
+      pntr_set_error(PNTR_ERROR_NO_MEMORY);
+      return false;
+    }
+    PNTR_MEMSET(waves, 0, sizeof(SfxWave) * count);
+    pntr_app_sfx_render_batch(params, count, waves, 1);
+    for (i = 0; i < count; i++) {
+      size += (waves[i].size + 3) & ~(size_t)3;
+    }
+  }
+
+  fileData = (unsigned char*)_pntr_app_sfx_malloc(size);
+  result = fileData != NULL;
+  if (result) {
+    header.count = (uint32_t)count;
+    _pntr_app_sfx_write_bank_header(fileData, &header);
+    waveOffset = sizeof(SfxBankHeader) + (sizeof(SfxBankEntry) + sizeof(SfxParams)) * count;
+    for (i = 0; i < count; i++) {
+      PNTR_MEMSET(&entry, 0, sizeof(SfxBankEntry));
+      for (j = 0; j < SFX_BANK_NAME_LENGTH - 1 && names[order[i]][j] != '\0'; j++) {
+        entry.name[j] = names[order[i]][j];
+      }
+      entry.paramsOffset = (uint32_t)(sizeof(SfxBankHeader) + sizeof(SfxBankEntry) * count + sizeof(SfxParams) * i);
+      _pntr_app_sfx_write_bank_params(fileData + entry.paramsOffset, &params[order[i]]);
+
+      if (waves != NULL && waves[order[i]].data != NULL) {
+        entry.waveOffset = (uint32_t)waveOffset;
+        entry.waveSize = (uint32_t)waves[order[i]].size;
+        PNTR_MEMCPY(fileData + waveOffset, waves[order[i]].data, entry.waveSize);
+        PNTR_MEMSET(fileData + waveOffset + entry.waveSize, 0, ((entry.waveSize + 3) & ~3u) - entry.waveSize);
+        waveOffset += (entry.waveSize + 3) & ~(size_t)3;
+      }
+      _pntr_app_sfx_write_bank_entry(fileData + sizeof(SfxBankHeader) + sizeof(SfxBankEntry) * i, &entry);
+    }
+
+    result = pntr_save_file(fileName, fileData, (unsigned int)size);
+    _pntr_app_sfx_free(fileData);
+  } else {
+    pntr_set_error(PNTR_ERROR_NO_MEMORY);
+  }
+
+  if (waves != NULL) {
+    for (i = 0; i < count; i++) {
+      pntr_app_sfx_unload_wave(&waves[i]);
+    }
+    _pntr_app_sfx_free(waves);
+  }
+  _pntr_app_sfx_free(order);
+  return result;
+}
+
+/*
+ * Create a mixer with a fixed pool of voiceCount voices, rendering at
+ * sampleRate. Triggering and mixing sounds allocates nothing after this.
+ *
+ * The mixer is not locked: use it from one thread, or guard it.
+ * Unload it with pntr_app_sfx_unload_mixer().
+ */
+SfxMixer* pntr_app_sfx_load_mixer(int voiceCount, int sampleRate) {
+  SfxMixer* mixer;
+  int i;
+
+  if (voiceCount <= 0 || sampleRate < 0 || sampleRate > PNTR_APP_SFX_MAX_SAMPLE_RATE) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return NULL;
+  }
+
+  mixer = (SfxMixer*)_pntr_app_sfx_malloc(sizeof(SfxMixer) + sizeof(SfxVoice) * (size_t)voiceCount);
+  if (mixer == NULL) {
+    pntr_set_error(PNTR_ERROR_NO_MEMORY);
+    return NULL;
+  }
+
+  mixer->sampleRate = sampleRate > 0 ? sampleRate : 44100;
+  mixer->supersample = 8;
+  mixer->gain = 1.0f;
+  mixer->voiceCount = voiceCount;
+  mixer->nextId = 1;
+  mixer->voices = (SfxVoice*)(mixer + 1);
+  for (i = 0; i < voiceCount; i++) {
+    mixer->voices[i].id = 0;
+  }
+  return mixer;
+}
+
+/*
+ * Unload a mixer, stopping all of its voices.
+ */
+void pntr_app_sfx_unload_mixer(SfxMixer* mixer) {
+  _pntr_app_sfx_free(mixer);
+}
+
+// Find the voice playing a handle, or NULL once it has ended.
+static SfxVoice* _pntr_app_sfx_mixer_voice(SfxMixer* mixer, uint32_t voice) {
+  int i;
+
+  if (mixer == NULL || voice == 0) {
+    return NULL;
+  }
+  for (i = 0; i < mixer->voiceCount; i++) {
+    if (mixer->voices[i].id == voice) {
+      return &mixer->voices[i];
+    }
+  }
+  return NULL;
+}
+
+// Take a free voice, or steal the oldest one with the lowest priority, as
+// long as that is not above priority. NULL when every voice outranks it.
+static SfxVoice* _pntr_app_sfx_mixer_take(SfxMixer* mixer, int priority) {
+  SfxVoice* voice = NULL;
+  SfxVoice* candidate;
+  int i;
+
+  for (i = 0; i < mixer->voiceCount; i++) {
+    candidate = &mixer->voices[i];
+    if (candidate->id == 0) {
+      return candidate;
+    }
+    if (candidate->priority <= priority && (voice == NULL || candidate->priority < voice->priority || (candidate->priority == voice->priority && candidate->id < voice->id))) {
+      voice = candidate;
+    }
+  }
+  return voice;
+}
+
+// Start a voice taken by _pntr_app_sfx_mixer_take(), whose state is already begun.
+static uint32_t _pntr_app_sfx_mixer_start(SfxMixer* mixer, SfxVoice* voice, float gain, int priority) {
+  voice->state.supersample = mixer->supersample;
+  voice->priority = priority;
+  voice->gain = gain;
+  voice->id = mixer->nextId++;
+  if (mixer->nextId == 0) {
+    mixer->nextId = 1;
+  }
+  return voice->id;
+}
+
+/*
+ * Start rendering params on a voice of the mixer, at the given gain.
+ * When every voice is busy, the one with the lowest priority is stolen,
+ * the oldest first, as long as its priority is not above priority.
+ *
+ * Return a handle to the voice, or 0 if no voice could be taken.
+ */
+uint32_t pntr_app_sfx_mixer_play(SfxMixer* mixer, const SfxParams* params, float gain, int priority) {
+  SfxVoice* voice;
+
+  if (mixer == NULL || params == NULL) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return 0;
+  }
+
+  voice = _pntr_app_sfx_mixer_take(mixer, priority);
+  if (voice == NULL) {
+    return 0;
+  }
+  pntr_app_sfx_begin_render_ex(&voice->state, params, SFX_F32, mixer->sampleRate);
+  return _pntr_app_sfx_mixer_start(mixer, voice, gain, priority);
+}
+
+/*
+ * Like pntr_app_sfx_mixer_play(), for a patch compiled at the mixer's sample
+ * rate. This skips compiling the params on every trigger.
+ *
+ * A patch compiled at another rate would play at the wrong pitch and length,
+ * so it is rejected with PNTR_ERROR_INVALID_ARGS.
+ */
+uint32_t pntr_app_sfx_mixer_play_patch(SfxMixer* mixer, const SfxPatch* patch, float gain, int priority) {
+  SfxVoice* voice;
+
+  if (mixer == NULL || patch == NULL || patch->sampleRate != mixer->sampleRate) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return 0;
+  }
+
+  voice = _pntr_app_sfx_mixer_take(mixer, priority);
+  if (voice == NULL) {
+    return 0;
+  }
+  pntr_app_sfx_begin_render_patch(&voice->state, patch, SFX_F32);
+  return _pntr_app_sfx_mixer_start(mixer, voice, gain, priority);
+}
+
+/*
+ * Stop a voice right away. Handles of voices that already ended are ignored.
+ */
+void pntr_app_sfx_mixer_stop(SfxMixer* mixer, uint32_t voice) {
+  SfxVoice* v = _pntr_app_sfx_mixer_voice(mixer, voice);
+  if (v != NULL) {
+    v->id = 0;
+  }
+}
+
+/*
+ * Change the gain of a playing voice.
+ */
+void pntr_app_sfx_mixer_set_gain(SfxMixer* mixer, uint32_t voice, float gain) {
+  SfxVoice* v = _pntr_app_sfx_mixer_voice(mixer, voice);
+  if (v != NULL) {
+    v->gain = gain;
+  }
+}
+
+/*
+ * Check whether a voice is still playing.
+ */
+bool pntr_app_sfx_mixer_playing(SfxMixer* mixer, uint32_t voice) {
+  return _pntr_app_sfx_mixer_voice(mixer, voice) != NULL;
+}
+
+// Frames mixed at a time, in buffers on the stack.
+#define _SFX_MIXER_BLOCK 256
+
+/*
+ * Mix frames samples of every playing voice into out, in the given
+ * SfxSampleFormat. Voices are summed in float, scaled by the master gain,
+ * and converted once, so out is silence when nothing is playing.
+ *
+ * Return the number of voices that were playing.
+ */
+int pntr_app_sfx_mixer_render(SfxMixer* mixer, void* out, int frames, int format) {
+  float mix[_SFX_MIXER_BLOCK];
+  float voiceSamples[_SFX_MIXER_BLOCK];
+  int playing = 0;
+  int offset, count, rendered, i, j;
+  float sample;
+
+  if (mixer == NULL || out == NULL || frames < 0) {
+    pntr_set_error(PNTR_ERROR_INVALID_ARGS);
+    return 0;
+  }
+
+  for (i = 0; i < mixer->voiceCount; i++) {
+    playing += mixer->voices[i].id != 0;
+  }
+
+  for (offset = 0; offset < frames; offset += count) {
+    count = frames - offset;
+    if (count > _SFX_MIXER_BLOCK) {
+      count = _SFX_MIXER_BLOCK;
+    }
+
+    for (j = 0; j < count; j++) {
+      mix[j] = 0.0f;
+    }
+
+    for (i = 0; i < mixer->voiceCount; i++) {
+      SfxVoice* voice = &mixer->voices[i];
+      if (voice->id == 0) {
+        continue;
+      }
+
+      rendered = pntr_app_sfx_render(&voice->state, voiceSamples, count);
+      for (j = 0; j < rendered; j++) {
+        mix[j] += voiceSamples[j] * voice->gain;
+      }
+      if (rendered < count) {
+        voice->id = 0;
+      }
+    }
+
+    for (j = 0; j < count; j++) {
+      sample = mix[j] * mixer->gain;
+      if (sample > 1.0f)
+        sample = 1.0f;
+      else if (sample < -1.0f)
+        sample = -1.0f;
+
+      switch (format) {
+        case SFX_U8:
+          ((uint8_t*)out)[offset + j] = (uint8_t)(sample * 127.0f + 128.0f);
+          break;
+        case SFX_I16:
+          ((int16_t*)out)[offset + j] = (int16_t)(sample * 32767.0f);
+          break;
+        default:
+          ((float*)out)[offset + j] = sample;
+          break;
+      }
+    }
+  }
+
+  return playing;
 }
 
 #endif  // PNTR_APP_SFX_IMPLEMENTATION_ONCE